@@ -10,65 +10,348 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+#include <signal.h>
 
 // Module includes
 #include "audioMixer.h"
+#include "sampleBank.h"
 #include "beatGenerator.h"
 #include "udpServer.h"
 #include "inputMan.h" 
+#include "rtProfile.h"
+#include "renderPool.h"
+#include "voiceAllocator.h"
+#include "loopCache.h"
+#include "trace.h"
+#include "logger.h"
 
 // --- Configuration Constants ---
 
-// The path to the WAV files relative to the executable.
-// Ensure these files exist in the target directory or the app will fail to start.
+// The folder of WAV files relative to the executable. Every .wav in it is loaded
+// into the sample bank. Ensure it exists in the target directory or the app will fail to start.
 // Matches the assignment folder structure: ~/ensc351/public/myApps/beatbox-wav-files/
-#define FILE_PATH_BASE   "beatbox-wav-files/100051__menegass__gui-drum-bd-hard.wav"
-#define FILE_PATH_SNARE  "beatbox-wav-files/100059__menegass__gui-drum-snare-soft.wav"
-#define FILE_PATH_HIHAT  "beatbox-wav-files/100053__menegass__gui-drum-cc.wav"
+#define FILE_PATH_SAMPLES "beatbox-wav-files"
 
-int main(void)
+// Sounds that play the three drum roles (base, snare, hi-hat)
+#define SOUND_NAME_BASE  "gui-drum-bd-hard"
+#define SOUND_NAME_SNARE "gui-drum-snare-soft"
+#define SOUND_NAME_HIHAT "gui-drum-cc"
+
+// Hi-hat sounds share a choke group: a new hit cuts the ringing one off
+#define SOUND_NAME_HIHAT_CLOSED "gui-drum-ch"
+#define SOUND_NAME_HIHAT_OPEN   "gui-drum-co"
+#define CHOKE_GROUP_HIHAT 1
+
+// Extra drum patterns (optional; the built-in Rock/Custom beats are always available)
+#define FILE_PATH_PATTERNS "beatbox-patterns.txt"
+
+// Set by SIGUSR1: dump the event trace from the main loop (not from the handler)
+static volatile sig_atomic_t s_traceRequested = 0;
+
+static void onTraceSignal(int sig)
+{
+    (void)sig;
+    s_traceRequested = 1;
+}
+
+static void printUsage(const char *progName)
+{
+    printf("Usage: %s [options]\n", progName);
+    printf("  --output SPEC   Audio output: alsa[:device] (default), wav:<file>, or null\n");
+    printf("  --fast          Run wav/null outputs as fast as possible instead of in real time\n");
+    printf("  --resample Q    Resampler for samples not at 44.1 kHz: linear, cubic, or sinc (default)\n");
+    printf("  --period FRAMES Frames rendered per write / ALSA period size (default %d)\n",
+           AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES);
+    printf("  --periods N     ALSA periods in the device buffer (default %d)\n",
+           AUDIOOUTPUT_DEFAULT_PERIOD_COUNT);
+    printf("  --low-latency   Shorthand for --period %d --periods %d (for air drumming)\n",
+           AUDIOOUTPUT_LOW_LATENCY_PERIOD_FRAMES, AUDIOOUTPUT_LOW_LATENCY_PERIOD_COUNT);
+    printf("  --polyphony N   Voices that may sound at once (default %d, max %d)\n",
+           VOICEALLOC_DEFAULT_POLYPHONY, VOICEALLOC_MAX_VOICES);
+    printf("  --steal MODE    Voice to fade out past the polyphony: oldest (default) or quietest\n");
+    printf("  --no-loop-cache Mix drum patterns hit by hit instead of pre-rendering each bar\n");
+    printf("  --render-threads N  Split busy periods across N voice render threads (default 1)\n");
+    printf("  --log-file FILE Append status and runtime messages to FILE instead of the console\n");
+    printf("  --log-level L   Least important messages shown: debug, info (default), warn, error\n");
+    printf("  --bench-render  Benchmark voice rendering on 1..#CPUs threads and exit\n");
+    printf("  --bench-udp     Benchmark UDP command throughput over loopback and exit\n");
+    printf("  --realtime      SCHED_FIFO priorities, CPU pinning and locked memory (needs privileges)\n");
+    printf("  --build-bank    Rebuild the kit's binary bank cache and exit\n");
+    printf("  --help          Show this message\n");
+}
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Parse a positive integer option in [minValue, maxValue]. Returns false if invalid.
+static bool parseCount(const char *text, long minValue, long maxValue, long *pValue)
 {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < minValue || value > maxValue) {
+        return false;
+    }
+    *pValue = value;
+    return true;
+}
+
+// Parse command-line options into the audio output configuration.
+// Returns false (after printing usage) if the arguments are invalid.
+static bool parseArgs(int argc, char *argv[], AudioOutputConfig *pOutput, bool *pBuildBank, bool *pRealTime,
+                      bool *pBenchRender, bool *pBenchUdp, const char **pLogPath)
+{
+    static const struct option longOpts[] = {
+        { "output", required_argument, NULL, 'o' },
+        { "fast",   no_argument,       NULL, 'f' },
+        { "resample", required_argument, NULL, 'r' },
+        { "period", required_argument, NULL, 'p' },
+        { "periods", required_argument, NULL, 'n' },
+        { "low-latency", no_argument,  NULL, 'l' },
+        { "polyphony", required_argument, NULL, 'v' },
+        { "steal", required_argument,  NULL, 's' },
+        { "no-loop-cache", no_argument, NULL, 'L' },
+        { "render-threads", required_argument, NULL, 't' },
+        { "log-file", required_argument, NULL, 'g' },
+        { "log-level", required_argument, NULL, 'e' },
+        { "bench-render", no_argument, NULL, 'B' },
+        { "bench-udp", no_argument,    NULL, 'U' },
+        { "realtime", no_argument,     NULL, 'R' },
+        { "build-bank", no_argument,   NULL, 'b' },
+        { "help",   no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    AudioOutput_getDefaultConfig(pOutput);
+    *pBuildBank = false;
+    *pRealTime = false;
+    *pBenchRender = false;
+    *pBenchUdp = false;
+    *pLogPath = NULL;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:fr:p:n:lv:s:Lt:g:e:BURbh", longOpts, NULL)) != -1) {
+        switch (opt) {
+            case 'o':
+                if (!AudioOutput_parseSpec(optarg, pOutput)) {
+                    printf("ERROR: Unknown output '%s'.\n", optarg);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                break;
+            case 'f':
+                pOutput->realTime = false;
+                break;
+            case 'r': {
+                ResampleQuality quality;
+                if (!SampleConvert_parseQuality(optarg, &quality)) {
+                    printf("ERROR: Unknown resampler '%s'.\n", optarg);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                AudioMixer_setResampleQuality(quality);
+                break;
+            }
+            case 'p':
+            case 'n': {
+                long value;
+                bool isPeriod = (opt == 'p');
+                if (!parseCount(optarg, isPeriod ? 16 : 2, isPeriod ? 8192 : 32, &value)) {
+                    printf("ERROR: Invalid %s '%s'.\n", isPeriod ? "period size" : "period count", optarg);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                if (isPeriod) {
+                    pOutput->periodFrames = (unsigned long)value;
+                } else {
+                    pOutput->periodCount = (unsigned int)value;
+                }
+                break;
+            }
+            case 'l':
+                pOutput->periodFrames = AUDIOOUTPUT_LOW_LATENCY_PERIOD_FRAMES;
+                pOutput->periodCount = AUDIOOUTPUT_LOW_LATENCY_PERIOD_COUNT;
+                break;
+            case 'v': {
+                long polyphony;
+                if (!parseCount(optarg, 1, VOICEALLOC_MAX_VOICES, &polyphony)) {
+                    printf("ERROR: Invalid polyphony '%s' (1-%d).\n", optarg, VOICEALLOC_MAX_VOICES);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                VoiceAlloc_setPolyphony((int)polyphony);
+                break;
+            }
+            case 's': {
+                VoiceStealMode mode;
+                if (!VoiceAlloc_parseStealMode(optarg, &mode)) {
+                    printf("ERROR: Unknown steal mode '%s'.\n", optarg);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                VoiceAlloc_setStealMode(mode);
+                break;
+            }
+            case 'L':
+                LoopCache_setEnabled(false);
+                break;
+            case 't': {
+                long threads;
+                if (!parseCount(optarg, 1, RENDERPOOL_MAX_WORKERS, &threads)) {
+                    printf("ERROR: Invalid render thread count '%s' (1-%d).\n", optarg, RENDERPOOL_MAX_WORKERS);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                AudioMixer_setRenderThreads((int)threads);
+                break;
+            }
+            case 'g':
+                *pLogPath = optarg;
+                break;
+            case 'e': {
+                LogLevel level;
+                if (!Log_parseLevel(optarg, &level)) {
+                    printf("ERROR: Unknown log level '%s'.\n", optarg);
+                    printUsage(argv[0]);
+                    return false;
+                }
+                Log_setLevel(level);
+                break;
+            }
+            case 'B':
+                *pBenchRender = true;
+                break;
+            case 'U':
+                *pBenchUdp = true;
+                break;
+            case 'R':
+                *pRealTime = true;
+                break;
+            case 'b':
+                *pBuildBank = true;
+                break;
+            case 'h':
+                printUsage(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                printUsage(argv[0]);
+                return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    long long launchNs = nowNs(); // For the cold-start-to-first-sound report
+
+    AudioOutputConfig outputConfig;
+    bool buildBank, realTime, benchRender, benchUdp;
+    const char *logPath;
+    if (!parseArgs(argc, argv, &outputConfig, &buildBank, &realTime, &benchRender, &benchUdp, &logPath)) {
+        return EXIT_FAILURE;
+    }
+
+    // Offline step: measure how voice rendering scales with threads, then quit
+    if (benchRender) {
+        long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return (AudioMixer_runRenderBenchmark((int)numCpus) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Offline step: measure how many commands per second the UDP server answers, then quit
+    if (benchUdp) {
+        return (UdpServer_runBenchmark() == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // Offline step: convert the kit into its binary bank cache, then quit
+    if (buildBank) {
+        int count = SampleBank_rebuildCache(FILE_PATH_SAMPLES);
+        SampleBank_free();
+        return (count > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     printf("Starting BeatBox app...\n");
+
+    // 0. Real-time profile (before any thread starts, so each one picks it up)
+    RtProfile_init(realTime);
+
+    // Runtime messages (status line, knob changes, errors) go through the log
+    // writer thread, so a slow console never stalls the threads that print them
+    Log_init(logPath);
     
     // 1. Initialize the Audio Subsystem first
     // We need the mixer ready before we can load any sound data into it.
-    AudioMixer_init();
+    AudioMixer_init(&outputConfig);
 
-    // 2. Load the drum sounds into memory
-    // These calls read the WAV files from the disk and store the PCM data
-    // in structs that the mixer can access quickly during playback.
-    wavedata_t baseSound, snareSound, hiHatSound;
-    
-    if (!AudioMixer_readWaveFileIntoMemory(FILE_PATH_BASE, &baseSound) ||
-        !AudioMixer_readWaveFileIntoMemory(FILE_PATH_SNARE, &snareSound) ||
-        !AudioMixer_readWaveFileIntoMemory(FILE_PATH_HIHAT, &hiHatSound))
-    {
+    // 2. Load the drum kit into memory
+    // Every WAV file is read from disk into one sample bank arena that the mixer
+    // can access quickly during playback (or the bank cache is mapped, if current).
+    // Other modules refer to sounds by ID.
+    int baseId = -1, snareId = -1, hiHatId = -1;
+    if (SampleBank_load(FILE_PATH_SAMPLES) > 0) {
+        baseId = SampleBank_findByName(SOUND_NAME_BASE);
+        snareId = SampleBank_findByName(SOUND_NAME_SNARE);
+        hiHatId = SampleBank_findByName(SOUND_NAME_HIHAT);
+    }
+    if (baseId < 0 || snareId < 0 || hiHatId < 0) {
         printf("ERROR: Failed to load wave files.\n");
         printf("  Ensure the 'beatbox-wav-files' folder is in the same directory as the executable.\n");
         // We cannot proceed without audio assets.
         exit(EXIT_FAILURE);
     }
+    SampleBank_setAlias(SAMPLEBANK_ROLE_BASE, baseId);
+    SampleBank_setAlias(SAMPLEBANK_ROLE_SNARE, snareId);
+    SampleBank_setAlias(SAMPLEBANK_ROLE_HIHAT, hiHatId);
+    SampleBank_setChokeGroup(SOUND_NAME_HIHAT, CHOKE_GROUP_HIHAT);
+    SampleBank_setChokeGroup(SOUND_NAME_HIHAT_CLOSED, CHOKE_GROUP_HIHAT);
+    SampleBank_setChokeGroup(SOUND_NAME_HIHAT_OPEN, CHOKE_GROUP_HIHAT);
     printf("Audio assets loaded successfully.\n");
 
     // 3. Initialize Control Modules
-    // We pass pointers to the loaded sounds so these modules can trigger
+    // Sounds are referenced by sample bank ID, so these modules can trigger
     // playback without needing to know about file paths or memory management.
-    BeatGenerator_init(&baseSound, &snareSound, &hiHatSound);
+    BeatGenerator_init(FILE_PATH_PATTERNS);
     
     // Initialize UDP Server (Listens on Port 12345 for Node.js commands)
-    UdpServer_init(&baseSound, &snareSound, &hiHatSound);
+    UdpServer_init();
     
     // Initialize Input Manager (Handles Joystick, Rotary Encoder, Accelerometer)
-    InputMan_init(&baseSound, &snareSound, &hiHatSound);
+    InputMan_init();
     
+    // 'kill -USR1 <pid>' dumps the event trace to TRACE_DEFAULT_PATH
+    struct sigaction traceAction = { .sa_handler = onTraceSignal };
+    sigemptyset(&traceAction.sa_mask);
+    sigaction(SIGUSR1, &traceAction, NULL);
+
     printf("BeatBox fully initialized. Entering main loop.\n");
 
     // 4. Main Event Loop
     // The main thread's only job now is to wait. The actual work is being done
     // by the pthreads created in the Init functions above.
     // We check the UDP server status to see if a remote shutdown command was sent.
+    bool startupReported = false;
     while (!UdpServer_shouldQuit()) {
         sleep(1); 
+
+        // Report startup latency once the first sound has gone out
+        long long firstSoundNs = AudioMixer_getFirstSoundNs();
+        if (!startupReported && firstSoundNs != 0) {
+            printf("Startup: first sound %.1f ms after launch.\n", (firstSoundNs - launchNs) / 1e6);
+            startupReported = true;
+        }
+
+        if (s_traceRequested) {
+            s_traceRequested = 0;
+            int count = Trace_dump(NULL);
+            if (count >= 0) {
+                Log_write(LOG_LEVEL_INFO, "Trace: Wrote %d events to %s.", count, TRACE_DEFAULT_PATH);
+            }
+        }
     }
 
     // 5. Cleanup Sequence
@@ -80,13 +363,15 @@ int main(void)
     UdpServer_cleanup();
     BeatGenerator_cleanup();
     
-    // Release the memory holding the raw PCM audio data
-    AudioMixer_freeWaveFileData(&baseSound);
-    AudioMixer_freeWaveFileData(&snareSound);
-    AudioMixer_freeWaveFileData(&hiHatSound);
-    
-    // Finally, close the ALSA PCM handle and kill the playback thread
+    // Kill the playback thread and close the audio output
     AudioMixer_cleanup();
+
+    // Finally, release the memory holding the raw PCM audio data
+    // (after the mixer, which may still be reading it)
+    SampleBank_free();
+
+    // Flush the last queued messages
+    Log_cleanup();
     
     printf("BeatBox app shutdown complete.\n");
 
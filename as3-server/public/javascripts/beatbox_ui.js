@@ -71,16 +71,16 @@ $(document).ready(function() {
 	});
 
 	$('#hi-hat').click(function() {
-		console.log("Playing 1");
-		sendCommandToServer('play', '1');
+		console.log("Playing hihat");
+		sendCommandToServer('play', 'hihat');
 	});
 	$('#snare').click(function() {
-		console.log("Playing 2");
-		sendCommandToServer('play', "2");
+		console.log("Playing snare");
+		sendCommandToServer('play', "snare");
 	});
 	$('#base').click(function() {
-		console.log("Playing 0");
-		sendCommandToServer('play', "0");
+		console.log("Playing base");
+		sendCommandToServer('play', "base");
 	});
 
 	$('#stop').click(function() {
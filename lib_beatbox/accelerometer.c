@@ -7,7 +7,7 @@
 
 #include "accelerometer.h"
 #include "intervalTimer.h"
-#include "audioMixer.h"
+#include "sampleBank.h"
 #include "mpc3208.h" // Low-level SPI driver for the ADC
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,11 +33,18 @@
 // (a single shake registering as multiple hits).
 #define DEBOUNCE_CYCLES 15 
 
+// Change on any axis that counts as the board being moved (well above ADC noise,
+// well below a hit), so the input thread can leave its idle poll rate early.
+#define THRESHOLD_MOTION 40
+
 // --- Private Variables ---
 
-static wavedata_t* s_pBase = NULL;
-static wavedata_t* s_pSnare = NULL;
-static wavedata_t* s_pHiHat = NULL;
+// Sample bank IDs of the sounds each axis triggers, resolved from the role
+// aliases for the current kit (and again after a kit swap)
+static int s_baseId = -1;
+static int s_snareId = -1;
+static int s_hiHatId = -1;
+static unsigned int s_kitGeneration = 0;
 
 // Store the previous reading to calculate the delta (change)
 static int s_lastX = 0, s_lastY = 0, s_lastZ = 0;
@@ -50,10 +57,16 @@ static int readAccelChannel(int channel) {
     return mpc3208_read_channel(channel);
 }
 
-void Accelerometer_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat) {
-    s_pBase = pBase;
-    s_pSnare = pSnare;
-    s_pHiHat = pHiHat;
+// Look the role sounds up in the current kit
+static void resolveSounds(void) {
+    s_kitGeneration = SampleBank_getGeneration();
+    s_baseId = SampleBank_findByName(SAMPLEBANK_ROLE_BASE);
+    s_snareId = SampleBank_findByName(SAMPLEBANK_ROLE_SNARE);
+    s_hiHatId = SampleBank_findByName(SAMPLEBANK_ROLE_HIHAT);
+}
+
+void Accelerometer_init(void) {
+    resolveSounds();
 
     // Seed the "last" values with the current state so we don't 
     // trigger a sound immediately upon startup due to a 0 to N jump.
@@ -67,7 +80,7 @@ void Accelerometer_cleanup(void) {
     // No specific resource cleanup required for this module
 }
 
-void Accelerometer_poll(void) {
+bool Accelerometer_poll(void) {
     // Mark this event for the statistics module
     Interval_mark(INTERVAL_ACCEL);
 
@@ -76,6 +89,11 @@ void Accelerometer_poll(void) {
     int y = readAccelChannel(ACCEL_CHANNEL_Y);
     int z = readAccelChannel(ACCEL_CHANNEL_Z);
 
+    // Pick up the new role sounds if the kit was swapped
+    if (SampleBank_getGeneration() != s_kitGeneration) {
+        resolveSounds();
+    }
+
     // 2. Decrement debounce timers if they are active
     if (s_debounceX > 0) s_debounceX--;
     if (s_debounceY > 0) s_debounceY--;
@@ -87,24 +105,29 @@ void Accelerometer_poll(void) {
 
     // X Axis -> Snare
     if (s_debounceX == 0 && abs(x - s_lastX) > THRESHOLD_SNARE) {
-        AudioMixer_queueSound(s_pSnare);
+        SampleBank_play(s_snareId);
         s_debounceX = DEBOUNCE_CYCLES; // Start cooldown
     }
 
     // Y Axis -> Hi-Hat
     if (s_debounceY == 0 && abs(y - s_lastY) > THRESHOLD_HIHAT) {
-        AudioMixer_queueSound(s_pHiHat);
+        SampleBank_play(s_hiHatId);
         s_debounceY = DEBOUNCE_CYCLES;
     }
 
     // Z Axis -> Base
     if (s_debounceZ == 0 && abs(z - s_lastZ) > THRESHOLD_BASE) {
-        AudioMixer_queueSound(s_pBase);
+        SampleBank_play(s_baseId);
         s_debounceZ = DEBOUNCE_CYCLES;
     }
 
+    bool moved = abs(x - s_lastX) > THRESHOLD_MOTION
+              || abs(y - s_lastY) > THRESHOLD_MOTION
+              || abs(z - s_lastZ) > THRESHOLD_MOTION;
+
     // 4. Update history for the next poll
     s_lastX = x;
     s_lastY = y;
     s_lastZ = z;
+    return moved;
 }
\ No newline at end of file
@@ -1,10 +1,11 @@
 #ifndef ACCELEROMETER_H
 #define ACCELEROMETER_H
 
-#include "audioMixer.h"
+#include <stdbool.h>
 
-// Initializes the accelerometer module and stores pointers to the drum sounds
-void Accelerometer_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat);
+// Initializes the accelerometer module.
+// Each axis plays a drum role (base, snare, hi-hat) from the current sample bank kit.
+void Accelerometer_init(void);
 
 // Cleans up any resources (if necessary)
 void Accelerometer_cleanup(void);
@@ -12,6 +13,7 @@ void Accelerometer_cleanup(void);
 // Main worker function.
 // Should be called periodically (e.g., every 10ms) from the input thread.
 // Reads the hardware, detects motion, and queues audio events.
-void Accelerometer_poll(void);
+// Returns true if the board moved since the last poll (even too little for a hit).
+bool Accelerometer_poll(void);
 
 #endif
\ No newline at end of file
@@ -1,106 +1,276 @@
 /*
  * Audio Mixer Module
- * * This module manages the ALSA PCM output. It runs a background thread that
+ * * This module manages the audio output. It runs a background thread that
  * continually fills an audio buffer by "mixing" (adding) together all active
- * sound effects. 
+ * sound effects, and hands each buffer to the selected output backend
+ * (ALSA sound card, .wav file, or null sink; see audioOutput). 
  * * Features:
- * - Support for playing multiple overlapping sounds (polyphony).
- * - Software volume control.
- * - Clipping protection (prevents integer overflow when adding waves).
+ * - Support for playing multiple overlapping sounds (polyphony), with voice stealing
+ *   and choke groups (see voiceAllocator).
+ * - Interleaved stereo output. Each voice has its own Q15 gain, a constant-power
+ *   pan, and a pitch (fractional read position, linearly interpolated).
+ * - Software volume control (Q15 fixed-point gain).
+ * - Clipping protection: voices are summed into a 32-bit accumulator and
+ *   saturated to 16 bits once per buffer (see mixKernel for the SIMD loops).
+ * - Optional parallel rendering: active voices are split across a render pool;
+ *   each worker mixes into its own accumulator and the accumulators are summed in
+ *   worker order. Integer accumulation makes the result bit-identical to serial mixing.
+ * - Lock-free triggering: control threads push requests into a ring (triggerQueue)
+ *   which the playback thread drains once per buffer, so it never waits on a mutex.
+ * - Sample-accurate scheduling: a trigger may name an absolute frame on the mixer's
+ *   running frame clock, and the voice starts at that exact offset inside the buffer.
+ * - Latency measurement: for immediate triggers, the time from queueing to the
+ *   moment the voice's first frame reaches the DAC (per the output's delay report)
+ *   is recorded under INTERVAL_LATENCY.
  */
 
-// NOTE: This implementation relies on the ALSA library (libasound).
-// Assumes the hardware is plugged in as 'plughw:1,0' (typical for USB audio on BeagleBone).
-
 #include "audioMixer.h"
 #include "intervalTimer.h"
+#include "triggerQueue.h"
+#include "mixKernel.h"
+#include "audioOutput.h"
+#include "waveFile.h"
+#include "sampleConvert.h"
+#include "rtProfile.h"
+#include "renderPool.h"
+#include "voiceAllocator.h"
+#include "probe.h"
+#include "trace.h"
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
-#include <alsa/asoundlib.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <limits.h>
 #include <alloca.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <math.h>
 
 // --- Configuration Constants ---
 
-#define ALSA_PCM_DEVICE "plughw:1,0"
 #define DEFAULT_VOLUME 80
-#define SAMPLE_RATE    44100
-#define NUM_CHANNELS   1
-#define SAMPLE_SIZE    (sizeof(short)) // 16-bit audio = 2 bytes
+#define SAMPLE_RATE    AUDIOMIXER_SAMPLE_RATE
+#define SAMPLE_CHANNELS 1                          // Samples are stored mono
+#define OUTPUT_CHANNELS AUDIOMIXER_OUTPUT_CHANNELS // ...and mixed to interleaved stereo
+
+#define PITCH_UNITY_Q16 0x10000 // Step of one source sample per output frame
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NS_PER_SECOND 1000000000LL
 
-// Max number of concurrent sound clips we can mix at once.
-// If this is exceeded, new sounds will be dropped/ignored.
-#define MAX_ACTIVE_SOUNDS 30
+// Below this many active voices a period is rendered on the playback thread alone;
+// waking the render pool would cost more than it saves.
+#define PARALLEL_MIN_VOICES 16
 
 // --- Internal State ---
 
-static snd_pcm_t *handle;           // ALSA handle
+static const AudioOutputBackend *s_pOutput = NULL; // Where mixed audio is sent
 static bool s_audioInitialized = false; 
 
 static unsigned long playbackBufferSize = 0;
-static short *playbackBuffer = NULL; // The buffer we write to ALSA
+static short *playbackBuffer = NULL; // The buffer we write to the output (interleaved)
 
-// Structure to track a currently playing sound
+// Per render worker: a 32-bit accumulator its voices are summed into, and scratch
+// for a pitched voice's resampled block. Lane 0 (the playback thread) holds the final mix.
 typedef struct {
-	wavedata_t *pSound; // Pointer to the raw audio data
-	int location;       // Current index (sample offset) into that data
-} playbackSound_t;
-
-// Array of "voice slots"
-static playbackSound_t soundBites[MAX_ACTIVE_SOUNDS];
+	int32_t *pAcc;
+	int16_t *pPitch;
+	bool mixedAny;
+} renderLane_t;
+
+static renderLane_t s_lanes[RENDERPOOL_MAX_WORKERS];
+static int s_numRenderThreads = 1; // Requested size of the render pool
+
+// Work list of the period being rendered (playback thread writes, workers read)
+static mixerVoice_t *s_activeVoices[VOICEALLOC_MAX_VOICES];
+static int s_numActiveVoices = 0;
+static int s_renderFrames = 0;
+static int32_t s_renderMasterQ15 = 0;
+
+// Voice slots live in the voice allocator, owned by the playback thread: other
+// threads only ever reach them through the trigger queue, so no lock is needed.
+
+// Triggers that arrived while every voice slot was busy (and none could be stolen)
+static atomic_ulong s_voiceOverflowCount = 0;
+
+// Deadline telemetry, written by the playback thread after every period
+static atomic_ulong s_periodCount = 0;
+static atomic_ulong s_loadHistogram[AUDIOMIXER_LOAD_BUCKETS];
+static atomic_llong s_worstRenderNs = 0;
+static unsigned long s_lastXruns = 0; // Output under-runs already seen (playback thread only)
+static atomic_llong s_lastXrunNs = 0;
+
+// Running frame clock: index of the first frame of the next buffer to render.
+// Written by the playback thread only.
+static atomic_ullong s_frameClock = 0;
+
+// Clock anchor: the frame clock and CLOCK_MONOTONIC time at the start of the most
+// recent render, published with a sequence lock so readers see a consistent pair.
+static atomic_uint s_anchorSeq = 0;
+static atomic_ullong s_anchorFrame = 0;
+static atomic_llong s_anchorNs = 0;
+
+// Kit that ID triggers resolve against. Control threads publish it (s_currentKit);
+// the playback thread reads it once per buffer and records the copy it is using
+// (s_mixerKit), which tells the kit's owner when a replaced kit is out of use.
+static _Atomic(audioKit_t*) s_currentKit = NULL;
+static _Atomic(audioKit_t*) s_mixerKit = NULL;
+
+// Queue time of the earliest immediate trigger started in the buffer being rendered
+// (0 if none). Playback thread only.
+static long long s_bufferTriggerNs = 0;
+
+// When the first audible buffer went out (0 until then)
+static atomic_llong s_firstSoundNs = 0;
+
+// Idle fast path: a period with no voice is not mixed. playbackBuffer is zeroed
+// once and then written out as it is for as long as nothing plays.
+static bool s_bufferSilent = false; // playbackBuffer holds silence (playback thread only)
+static atomic_bool s_idle = false;  // The last period had no voice to mix
 
 // Threading controls
 static volatile _Bool stopping = false;
 static pthread_t playbackThreadId;
-static pthread_mutex_t audioMutex = PTHREAD_MUTEX_INITIALIZER;
 
-static int volume = DEFAULT_VOLUME; 
+static atomic_int volume = DEFAULT_VOLUME; 
+
+// Resampler used when a loaded file is not already at SAMPLE_RATE
+static ResampleQuality s_resampleQuality = RESAMPLE_SINC;
 
 // Forward declarations
 void* playbackThread(void* arg);
+static bool fillPlaybackBuffer(short *buff, int size);
+
+
+// --- Private Helpers ---
+
+static long long nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+}
+
+static float clampf(float v, float lo, float hi)
+{
+    return (v < lo) ? lo : (v > hi) ? hi : v;
+}
+
+// Convert voice parameters to the fixed-point form the playback thread uses,
+// so no floating point (or trigonometry) happens on the audio thread.
+static void setTriggerParams(audioTrigger_t *pTrigger, const audioVoiceParams_t *pParams)
+{
+    static const audioVoiceParams_t defaults = AUDIOMIXER_VOICE_DEFAULTS;
+    if (!pParams) {
+        pParams = &defaults;
+    }
+    float gain = clampf(pParams->gain, 0.0f, 1.0f);
+    float pan = clampf(pParams->pan, -1.0f, 1.0f);
+    float pitch = clampf(pParams->pitch, AUDIOMIXER_MIN_PITCH, AUDIOMIXER_MAX_PITCH);
+
+    // Constant power: left = cos(theta), right = sin(theta), theta from 0 to pi/2,
+    // so left^2 + right^2 stays 1 (each side is -3 dB at centre).
+    float theta = (pan + 1.0f) * (float)M_PI / 4.0f;
+    pTrigger->gainLeftQ15 = (int16_t)lrintf(gain * cosf(theta) * MIXKERNEL_UNITY_Q15);
+    pTrigger->gainRightQ15 = (int16_t)lrintf(gain * sinf(theta) * MIXKERNEL_UNITY_Q15);
+    pTrigger->stepQ16 = (uint32_t)lrintf(pitch * PITCH_UNITY_Q16);
+    pTrigger->chokeGroup = (pParams->chokeGroup > 0) ? pParams->chokeGroup : 0;
+}
+
+// --- Render Lanes ---
+
+static void renderJob(int worker, int numWorkers, void *pArg);
+
+// Allocate one lane per render thread and start the render pool.
+static bool startRendering(int numThreads, unsigned long frames)
+{
+    for (int i = 0; i < numThreads; i++) {
+        s_lanes[i].pAcc = malloc(frames * OUTPUT_CHANNELS * sizeof(*s_lanes[i].pAcc));
+        s_lanes[i].pPitch = malloc(frames * sizeof(*s_lanes[i].pPitch));
+        if (!s_lanes[i].pAcc || !s_lanes[i].pPitch) {
+            return false;
+        }
+        RtProfile_prefault(s_lanes[i].pAcc, frames * OUTPUT_CHANNELS * sizeof(*s_lanes[i].pAcc), true);
+        RtProfile_prefault(s_lanes[i].pPitch, frames * sizeof(*s_lanes[i].pPitch), true);
+    }
+    RenderPool_init(numThreads, renderJob);
+    return true;
+}
 
+static void stopRendering(void)
+{
+    RenderPool_cleanup();
+    for (int i = 0; i < RENDERPOOL_MAX_WORKERS; i++) {
+        free(s_lanes[i].pAcc);
+        free(s_lanes[i].pPitch);
+        s_lanes[i].pAcc = NULL;
+        s_lanes[i].pPitch = NULL;
+    }
+}
 
 // --- Public API ---
 
-void AudioMixer_init(void)
+void AudioMixer_init(const AudioOutputConfig *pOutputConfig)
 {
-    // Initialize the sound bite array to empty
-	for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-		soundBites[i].pSound = NULL;
-	}
+    // Initialize the voice slots to empty
+    VoiceAlloc_init();
+    TriggerQueue_init();
+    atomic_store(&s_voiceOverflowCount, 0);
+    atomic_store(&s_frameClock, 0);
+    atomic_store(&s_firstSoundNs, 0);
+    atomic_store(&s_periodCount, 0);
+    for (int i = 0; i < AUDIOMIXER_LOAD_BUCKETS; i++) {
+        atomic_store(&s_loadHistogram[i], 0);
+    }
+    atomic_store(&s_worstRenderNs, 0);
+    atomic_store(&s_lastXrunNs, 0);
+    s_lastXruns = 0;
+
+    AudioOutputConfig config;
+    if (pOutputConfig) {
+        config = *pOutputConfig;
+    } else {
+        AudioOutput_getDefaultConfig(&config);
+    }
+    config.sampleRate = SAMPLE_RATE;
+    config.channels = OUTPUT_CHANNELS;
 
-    // Open the PCM device
-	int err = snd_pcm_open(&handle, ALSA_PCM_DEVICE, SND_PCM_STREAM_PLAYBACK, 0);
+    // Open the requested output. If it is unavailable (e.g. no USB dongle), fall back
+    // to a real-time null sink so the rest of the pipeline still runs.
+    s_pOutput = AudioOutput_getBackend(config.type);
+	int err = s_pOutput ? s_pOutput->open(&config, &playbackBufferSize) : -1;
 	if (err < 0) {
-		printf("AudioMixer: Playback open error: %s\n", snd_strerror(err));
-        printf("AudioMixer: WARNING: Proceeding in SILENT mode (no audio output).\n");
-        s_audioInitialized = false;
-		return;
+        printf("AudioMixer: WARNING: Output '%s' unavailable, falling back to null sink (no audio output).\n",
+               s_pOutput ? s_pOutput->name : "?");
+        config.type = AUDIO_OUTPUT_NULL;
+        config.realTime = true;
+        s_pOutput = AudioOutput_getBackend(AUDIO_OUTPUT_NULL);
+        err = s_pOutput->open(&config, &playbackBufferSize);
+        if (err < 0) {
+            s_audioInitialized = false;
+            return;
+        }
 	}
     
     s_audioInitialized = true;
 
-    // Configure ALSA parameters: 16-bit Little Endian, 44.1kHz, Mono
-	err = snd_pcm_set_params(handle,
-			SND_PCM_FORMAT_S16_LE,
-			SND_PCM_ACCESS_RW_INTERLEAVED,
-			NUM_CHANNELS,
-			SAMPLE_RATE,
-			1,			// Allow software resampling
-			50000);		// Latency: 0.05 seconds
-	if (err < 0) {
-		printf("Playback set params error: %s\n", snd_strerror(err));
+    // Allocate the playback buffer based on what the output suggests
+	playbackBuffer = malloc(playbackBufferSize * OUTPUT_CHANNELS * sizeof(*playbackBuffer));
+	if (!playbackBuffer || !startRendering(s_numRenderThreads, playbackBufferSize)) {
+		printf("AudioMixer: Unable to allocate %lu-frame playback buffers.\n", playbackBufferSize);
 		exit(EXIT_FAILURE);
 	}
-
-    // Allocate the playback buffer based on what ALSA suggests
- 	unsigned long unusedBufferSize = 0;
-	snd_pcm_get_params(handle, &unusedBufferSize, &playbackBufferSize);
-	playbackBuffer = malloc(playbackBufferSize * sizeof(*playbackBuffer));
+	RtProfile_prefault(playbackBuffer, playbackBufferSize * OUTPUT_CHANNELS * sizeof(*playbackBuffer), true);
+	printf("AudioMixer: Output '%s', %lu frames per period (%.1f ms), %s mixing kernel, %d render thread(s).\n",
+	       s_pOutput->name, playbackBufferSize, playbackBufferSize * 1000.0 / SAMPLE_RATE,
+	       MixKernel_getName(), RenderPool_getNumWorkers());
 
     // Start the mixing thread
 	pthread_create(&playbackThreadId, NULL, playbackThread, NULL);
@@ -109,77 +279,225 @@ void AudioMixer_init(void)
 _Bool AudioMixer_readWaveFileIntoMemory(char *fileName, wavedata_t *pSound)
 {
 	assert(pSound);
-    
-    // Wave files have a 44-byte header. The raw PCM data starts after that.
-	const int PCM_DATA_OFFSET = 44;
-    
-	FILE *file = fopen(fileName, "r");
-	if (file == NULL) {
-		fprintf(stderr, "ERROR: Unable to open file %s.\n", fileName);
-		return false;
-	}
+    pSound->numSamples = 0;
+    pSound->pData = NULL;
+    pSound->pMapping = NULL;
+    pSound->mappingSize = 0;
+
+    // Map the file and find its "fmt " and "data" chunks (no fixed 44-byte header assumed)
+    waveFile_t wave;
+    if (!WaveFile_open(fileName, &wave)) {
+        return false;
+    }
 
-    // Determine file size
-	fseek(file, 0, SEEK_END);
-	int sizeInBytes = ftell(file) - PCM_DATA_OFFSET;
-	pSound->numSamples = sizeInBytes / SAMPLE_SIZE;
-
-    // Allocate memory
-	fseek(file, PCM_DATA_OFFSET, SEEK_SET);
-	pSound->pData = malloc(sizeInBytes);
-	if (pSound->pData == 0) {
-		fprintf(stderr, "ERROR: Unable to allocate %d bytes for file %s.\n",
-				sizeInBytes, fileName);
-        fclose(file);
-		return false;
-	}
+    if (wave.formatTag != WAVEFILE_FORMAT_PCM || wave.bitsPerSample != 16
+            || wave.channels != SAMPLE_CHANNELS || wave.sampleRate != SAMPLE_RATE) {
+        // Not the engine format: convert now, so the audio thread never has to
+        if (!SampleConvert_isSupported(&wave)) {
+            Log_write(LOG_LEVEL_ERROR, "ERROR: %s uses an unsupported sample format (tag %d, %d-bit).",
+                      fileName, wave.formatTag, wave.bitsPerSample);
+            WaveFile_close(&wave);
+            return false;
+        }
+        pSound->pData = SampleConvert_toMono16(&wave, SAMPLE_RATE, s_resampleQuality, &pSound->numSamples);
+        Log_write(LOG_LEVEL_INFO, "AudioMixer: Converted %s (%d-channel %d-bit %s, %d Hz) with %s resampling.",
+                  fileName, wave.channels, wave.bitsPerSample,
+                  (wave.formatTag == WAVEFILE_FORMAT_FLOAT) ? "float" : "PCM",
+                  wave.sampleRate, SampleConvert_getQualityName(s_resampleQuality));
+        WaveFile_close(&wave);
+        if (pSound->pData == NULL) {
+            Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to convert file %s.", fileName);
+            pSound->numSamples = 0;
+            return false;
+        }
+        return true;
+    }
+    pSound->numSamples = (int)wave.numFrames;
+
+    // Zero-copy: the samples are already in the engine format, so play them
+    // straight out of the mapping (shared with the page cache).
+    if (WaveFile_isPcm16(&wave, SAMPLE_CHANNELS, SAMPLE_RATE)) {
+        pSound->pData = (short *)wave.pData;
+        pSound->pMapping = wave.pMapping;
+        pSound->mappingSize = wave.mappingSize;
+        return true;
+    }
 
-    // Read the raw PCM samples
-	int samplesRead = fread(pSound->pData, SAMPLE_SIZE, pSound->numSamples, file);
-	if (samplesRead != pSound->numSamples) {
-		fprintf(stderr, "ERROR: Unable to read %d samples from file %s (read %d).\n",
-				pSound->numSamples, fileName, samplesRead);
-        fclose(file);
+    // Right format but misaligned in the file: copy it out once
+	pSound->pData = malloc(wave.dataBytes);
+	if (pSound->pData == NULL) {
+		Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to allocate %zu bytes for file %s.",
+				  wave.dataBytes, fileName);
+        WaveFile_close(&wave);
 		return false;
 	}
-
-    fclose(file);
+    memcpy(pSound->pData, wave.pData, wave.dataBytes);
+    WaveFile_close(&wave);
 	return true;
 }
 
+void AudioMixer_setRenderThreads(int numThreads)
+{
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > RENDERPOOL_MAX_WORKERS) numThreads = RENDERPOOL_MAX_WORKERS;
+    s_numRenderThreads = numThreads;
+}
+
+void AudioMixer_setResampleQuality(ResampleQuality quality)
+{
+    s_resampleQuality = quality;
+}
+
+ResampleQuality AudioMixer_getResampleQuality(void)
+{
+    return s_resampleQuality;
+}
+
 void AudioMixer_freeWaveFileData(wavedata_t *pSound)
 {
 	pSound->numSamples = 0;
-	free(pSound->pData);
+    if (pSound->pMapping) {
+        munmap(pSound->pMapping, pSound->mappingSize);
+        pSound->pMapping = NULL;
+        pSound->mappingSize = 0;
+    } else {
+        free(pSound->pData);
+    }
 	pSound->pData = NULL;
 }
 
+void AudioMixer_setKit(audioKit_t *pKit)
+{
+    atomic_store_explicit(&s_currentKit, pKit, memory_order_release);
+}
+
+bool AudioMixer_isKitIdle(audioKit_t *pKit)
+{
+    if (!s_audioInitialized) {
+        return atomic_load(&s_currentKit) != pKit; // No playback thread to wait for
+    }
+    return atomic_load(&s_currentKit) != pKit
+        && atomic_load_explicit(&s_mixerKit, memory_order_acquire) != pKit
+        && atomic_load_explicit(&pKit->activeVoices, memory_order_acquire) == 0;
+}
+
+void AudioMixer_queueKitSoundAt(int soundId, unsigned long long startFrame,
+                                const audioVoiceParams_t *pParams)
+{
+	if (!s_audioInitialized) return;
+
+    audioTrigger_t trigger = { .pSound = NULL, .soundId = soundId, .startFrame = startFrame,
+                               .queuedNs = nowNs() };
+    setTriggerParams(&trigger, pParams);
+    Trace_event(TRACE_TRIGGER_QUEUED, soundId, startFrame != AUDIOMIXER_FRAME_NOW);
+    TriggerQueue_push(&trigger);
+}
+
+void AudioMixer_queuePinnedSoundAt(audioKit_t *pKit, int soundId, unsigned long long startFrame,
+                                   int chokeGroup)
+{
+	if (!s_audioInitialized) return;
+    assert(soundId >= 0 && soundId < pKit->numSounds);
+
+    audioTrigger_t trigger = { .pSound = &pKit->pSounds[soundId], .soundId = soundId, .pKit = pKit,
+                               .startFrame = startFrame, .queuedNs = nowNs(),
+                               .gainLeftQ15 = MIXKERNEL_UNITY_Q15, .gainRightQ15 = MIXKERNEL_UNITY_Q15,
+                               .stepQ16 = PITCH_UNITY_Q16, .chokeGroup = chokeGroup };
+
+    // Pin the kit before the trigger becomes visible; hand the pin back if it was dropped
+    atomic_fetch_add_explicit(&pKit->activeVoices, 1, memory_order_relaxed);
+    Trace_event(TRACE_TRIGGER_QUEUED, -1, startFrame != AUDIOMIXER_FRAME_NOW);
+    if (!TriggerQueue_push(&trigger)) {
+        atomic_fetch_sub_explicit(&pKit->activeVoices, 1, memory_order_release);
+    }
+}
+
+void AudioMixer_chokeAt(int chokeGroup, unsigned long long frame)
+{
+	if (!s_audioInitialized || chokeGroup <= 0) return;
+
+    audioTrigger_t trigger = { .pSound = NULL, .soundId = -1, .startFrame = frame,
+                               .queuedNs = nowNs(), .chokeGroup = chokeGroup };
+    TriggerQueue_push(&trigger);
+}
+
 void AudioMixer_queueSound(wavedata_t *pSound)
+{
+    AudioMixer_queueSoundAt(pSound, AUDIOMIXER_FRAME_NOW, NULL);
+}
+
+void AudioMixer_queueSoundAt(wavedata_t *pSound, unsigned long long startFrame,
+                             const audioVoiceParams_t *pParams)
 {
 	if (!s_audioInitialized) return;
 	assert(pSound->numSamples > 0);
 	assert(pSound->pData);
 
-	pthread_mutex_lock(&audioMutex);
+    // Hand the request to the playback thread. This never blocks; if the ring
+    // is full the trigger is dropped and counted by the queue.
+    audioTrigger_t trigger = { .pSound = pSound, .soundId = -1, .startFrame = startFrame,
+                               .queuedNs = nowNs() };
+    setTriggerParams(&trigger, pParams);
+    Trace_event(TRACE_TRIGGER_QUEUED, -1, startFrame != AUDIOMIXER_FRAME_NOW);
+    TriggerQueue_push(&trigger);
+}
 
-    // Find the first empty slot in our mixing array
-	int freeSlot = -1;
-	for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-		if (soundBites[i].pSound == NULL) {
-			freeSlot = i;
-			break;
-		}
-	}
+unsigned long long AudioMixer_getFrameClock(void)
+{
+    unsigned int seq;
+    unsigned long long frame;
+    long long anchorNs;
+
+    // Sequence lock read: retry if the playback thread re-anchored mid-read
+    do {
+        seq = atomic_load_explicit(&s_anchorSeq, memory_order_acquire);
+        frame = atomic_load_explicit(&s_anchorFrame, memory_order_relaxed);
+        anchorNs = atomic_load_explicit(&s_anchorNs, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&s_anchorSeq, memory_order_relaxed));
+
+    if (anchorNs == 0) {
+        return frame; // Playback has not started yet
+    }
 
-	if (freeSlot != -1) {
-		soundBites[freeSlot].pSound = pSound;
-		soundBites[freeSlot].location = 0; // Start playing from the beginning
-	} else {
-        // This happens if we try to play > MAX_ACTIVE_SOUNDS at once
-		printf("ERROR: No free sound bite slots available, skipping sound.\n");
-	}
+    // Interpolate from the anchor using the elapsed wall time
+    long long elapsedNs = nowNs() - anchorNs;
+    if (elapsedNs < 0) elapsedNs = 0;
+    return frame + (unsigned long long)(elapsedNs * SAMPLE_RATE / NS_PER_SECOND);
+}
+
+bool AudioMixer_isIdle(void)
+{
+    return atomic_load_explicit(&s_idle, memory_order_relaxed);
+}
+
+long long AudioMixer_getFirstSoundNs(void)
+{
+    return atomic_load(&s_firstSoundNs);
+}
 
-	pthread_mutex_unlock(&audioMutex);
+void AudioMixer_getDropStats(unsigned long *pQueueFull, unsigned long *pNoFreeVoice)
+{
+    if (pQueueFull) *pQueueFull = TriggerQueue_getDroppedCount();
+    if (pNoFreeVoice) *pNoFreeVoice = atomic_load(&s_voiceOverflowCount);
+}
+
+void AudioMixer_getStats(audioMixerStats_t *pStats)
+{
+    pStats->periods = atomic_load(&s_periodCount);
+    for (int i = 0; i < AUDIOMIXER_LOAD_BUCKETS; i++) {
+        pStats->loadHistogram[i] = atomic_load(&s_loadHistogram[i]);
+    }
+    long long periodNs = playbackBufferSize * NS_PER_SECOND / SAMPLE_RATE;
+    pStats->peakLoad = periodNs ? (double)atomic_load(&s_worstRenderNs) / (double)periodNs : 0.0;
+
+    pStats->xruns = 0;
+    pStats->xrunFailures = 0;
+    if (s_pOutput && s_pOutput->getXrunStats) {
+        s_pOutput->getXrunStats(&pStats->xruns, &pStats->xrunFailures);
+    }
+    pStats->lastXrunNs = atomic_load(&s_lastXrunNs);
+    AudioMixer_getDropStats(&pStats->queueDrops, &pStats->voiceDrops);
 }
 
 void AudioMixer_cleanup(void)
@@ -188,16 +506,17 @@ void AudioMixer_cleanup(void)
 	stopping = true;
 	pthread_join(playbackThreadId, NULL);
 
-	snd_pcm_drain(handle);
-	snd_pcm_close(handle);
+	s_pOutput->close();
+	s_audioInitialized = false;
 
 	free(playbackBuffer);
 	playbackBuffer = NULL;
+	stopRendering();
 }
 
 int AudioMixer_getVolume()
 {
-	return volume;
+	return atomic_load(&volume);
 }
 
 void AudioMixer_setVolume(int newVolume)
@@ -205,97 +524,464 @@ void AudioMixer_setVolume(int newVolume)
     // Clamp volume 0-100
 	if (newVolume < 0) newVolume = 0;
     if (newVolume > AUDIOMIXER_MAX_VOLUME) newVolume = AUDIOMIXER_MAX_VOLUME;
-	volume = newVolume; 
+	atomic_store(&volume, newVolume);
 
     // Note: This only changes software volume. 
     // Ideally, we would also control the hardware mixer (ALSA 'Line Out') here.
 }
 
-// --- Mixing Logic ---
+// --- Render Benchmark ---
 
-// This function fills the buffer with the next chunk of audio.
-// It iterates over all active sounds, adds their current samples together,
-// handles volume scaling, and clips the result to fit in a 16-bit short.
-static void fillPlaybackBuffer(short *buff, int size)
+#define BENCH_SOUND_FRAMES (SAMPLE_RATE * 10) // Long enough that no voice ends mid-run
+#define BENCH_WARMUP_PERIODS 20
+#define BENCH_PERIODS 400
+
+// Render BENCH_PERIODS periods with 'numVoices' voices on the current pool.
+// Returns the average render time; sets the worst case and an output checksum.
+static double benchmarkRun(wavedata_t *pSound, int numVoices, long long *pWorstNs, uint64_t *pChecksum)
 {
-    // Start with silence (0)
-    memset(buff, 0, size * SAMPLE_SIZE);
+    int polyphony = VoiceAlloc_getPolyphony();
+    VoiceAlloc_setPolyphony(VOICEALLOC_MAX_VOICES);
+    VoiceAlloc_init();
+    for (int i = 0; i < numVoices; i++) {
+        mixerVoice_t *pVoice = VoiceAlloc_allocate();
+        pVoice->pSound = pSound;
+        pVoice->location = (i * 997) % 4096; // Spread the read positions
+        pVoice->stepQ16 = (i % 2) ? PITCH_UNITY_Q16 * 3 / 2 : PITCH_UNITY_Q16; // Half pitched
+        pVoice->gainLeftQ15 = (int32_t)(MIXKERNEL_UNITY_Q15 / (1 + i % 4));
+        pVoice->gainRightQ15 = (int32_t)(MIXKERNEL_UNITY_Q15 / (1 + i % 3));
+    }
 
-    // Make a local copy of the sound bites to minimize mutex lock time
-    playbackSound_t localSoundBites[MAX_ACTIVE_SOUNDS];
-    
-    pthread_mutex_lock(&audioMutex);
-    for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-        localSoundBites[i] = soundBites[i];
+    long long totalNs = 0;
+    *pWorstNs = 0;
+    *pChecksum = 1469598103934665603ULL; // FNV-1a
+    for (int period = 0; period < BENCH_WARMUP_PERIODS + BENCH_PERIODS; period++) {
+        long long startNs = nowNs();
+        fillPlaybackBuffer(playbackBuffer, (int)playbackBufferSize);
+        long long elapsedNs = nowNs() - startNs;
+
+        if (period >= BENCH_WARMUP_PERIODS) {
+            totalNs += elapsedNs;
+            if (elapsedNs > *pWorstNs) *pWorstNs = elapsedNs;
+        }
+        for (unsigned long i = 0; i < playbackBufferSize * OUTPUT_CHANNELS; i++) {
+            *pChecksum = (*pChecksum ^ (uint16_t)playbackBuffer[i]) * 1099511628211ULL;
+        }
+    }
+
+    VoiceAlloc_init();
+    VoiceAlloc_setPolyphony(polyphony);
+    return (double)totalNs / BENCH_PERIODS;
+}
+
+int AudioMixer_runRenderBenchmark(int maxThreads)
+{
+    static const int voiceCounts[] = { 16, 32, 64, 128, 256 };
+    enum { NUM_COUNTS = sizeof(voiceCounts) / sizeof(voiceCounts[0]) };
+
+    if (s_audioInitialized) {
+        printf("AudioMixer: The render benchmark must run before AudioMixer_init().\n");
+        return -1;
+    }
+    if (maxThreads < 1) maxThreads = 1;
+    if (maxThreads > RENDERPOOL_MAX_WORKERS) maxThreads = RENDERPOOL_MAX_WORKERS;
+
+    // A deterministic noise burst stands in for a drum sample
+    wavedata_t sound = { .numSamples = BENCH_SOUND_FRAMES };
+    sound.pData = malloc(BENCH_SOUND_FRAMES * sizeof(short));
+    playbackBufferSize = AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES;
+    playbackBuffer = malloc(playbackBufferSize * OUTPUT_CHANNELS * sizeof(*playbackBuffer));
+    if (!sound.pData || !playbackBuffer) {
+        printf("AudioMixer: Unable to allocate benchmark buffers.\n");
+        free(sound.pData);
+        free(playbackBuffer);
+        playbackBuffer = NULL;
+        return -1;
     }
-    double volMultiplier = (double)volume / 100.0;
-    pthread_mutex_unlock(&audioMutex);
+    uint32_t seed = 12345;
+    for (int i = 0; i < BENCH_SOUND_FRAMES; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        sound.pData[i] = (short)((int32_t)(seed >> 16) - 32768) / 4;
+    }
+    atomic_store(&volume, AUDIOMIXER_MAX_VOLUME);
+
+    double periodUs = playbackBufferSize * 1e6 / SAMPLE_RATE;
+    printf("Render benchmark: %lu-frame periods (%.0f us), %s kernel, half the voices pitched.\n",
+           playbackBufferSize, periodUs, MixKernel_getName());
+    printf("threads voices   avg us  worst us  worst load  RT voices/core  output\n");
+
+    uint64_t serialChecksum[NUM_COUNTS] = { 0 };
+    bool allMatch = true;
+    for (int threads = 1; threads <= maxThreads; threads++) {
+        if (!startRendering(threads, playbackBufferSize)) {
+            printf("AudioMixer: Unable to allocate render lanes.\n");
+            break;
+        }
+        for (int c = 0; c < NUM_COUNTS; c++) {
+            long long worstNs;
+            uint64_t checksum;
+            double avgNs = benchmarkRun(&sound, voiceCounts[c], &worstNs, &checksum);
+            if (threads == 1) {
+                serialChecksum[c] = checksum;
+            }
+            bool match = (checksum == serialChecksum[c]);
+            allMatch = allMatch && match;
+
+            // Voices each core could render within one period, at the worst case seen
+            double worstUs = worstNs / 1000.0;
+            double voicesPerCore = voiceCounts[c] * (periodUs / worstUs) / RenderPool_getNumWorkers();
+            printf("%7d %6d %8.1f %9.1f %10.1f%% %15.0f  %s\n",
+                   RenderPool_getNumWorkers(), voiceCounts[c], avgNs / 1000.0, worstUs,
+                   100.0 * worstUs / periodUs, voicesPerCore, match ? "same" : "DIFFERENT");
+        }
+        stopRendering();
+    }
+
+    free(sound.pData);
+    free(playbackBuffer);
+    playbackBuffer = NULL;
+    playbackBufferSize = 0;
+    atomic_store(&volume, DEFAULT_VOLUME);
+    return allMatch ? 0 : -1;
+}
+
+// --- Mixing Logic ---
 
+// Move every trigger published since the last buffer into a free voice slot.
+// Runs on the playback thread only, once at the top of each buffer.
+static void drainTriggerQueue(unsigned long long bufferStartFrame)
+{
+    audioTrigger_t trigger;
+
+    // Take one snapshot of the kit per buffer, and say which one we hold
+    audioKit_t *pKit = atomic_load_explicit(&s_currentKit, memory_order_acquire);
+    atomic_store_explicit(&s_mixerKit, pKit, memory_order_release);
+
+    while (TriggerQueue_pop(&trigger)) {
+        // A scheduled trigger waits (negative location) until its start frame.
+        // Late or immediate triggers start at the top of this buffer.
+        int startDelay = 0;
+        if (trigger.startFrame > bufferStartFrame) {
+            unsigned long long delay = trigger.startFrame - bufferStartFrame;
+            if (delay > INT_MAX) delay = INT_MAX;
+            startDelay = (int)delay;
+        }
 
-    // Mix each active sound into the buffer
-    for (int i = 0; i < MAX_ACTIVE_SOUNDS; i++) {
-        if (localSoundBites[i].pSound == NULL) continue;
+        // Choke-only trigger
+        if (trigger.pSound == NULL && trigger.soundId < 0) {
+            VoiceAlloc_choke(trigger.chokeGroup, startDelay, NULL);
+            continue;
+        }
 
-        wavedata_t *sound = localSoundBites[i].pSound;
-        int location = localSoundBites[i].location;
+        // ID triggers play from the current kit; unknown IDs (e.g. from a kit
+        // that was just replaced by a smaller one) are dropped silently.
+        // Pinned triggers already hold a reference on their kit for the voice.
+        audioKit_t *pVoiceKit = trigger.pKit;
+        if (trigger.pSound == NULL) {
+            if (!pKit || trigger.soundId < 0 || trigger.soundId >= pKit->numSounds) {
+                continue;
+            }
+            trigger.pSound = &pKit->pSounds[trigger.soundId];
+            pVoiceKit = pKit;
+        }
 
-        for (int j = 0; j < size; j++) {
-            // Check if we reached the end of this specific sound clip
-            if (location + j >= sound->numSamples) {
-                // Mark the sound as finished in the shared array
-                pthread_mutex_lock(&audioMutex);
-                soundBites[i].pSound = NULL; 
-                pthread_mutex_unlock(&audioMutex);
-                break; 
+        // Take a voice slot (stealing one if polyphony is used up)
+        mixerVoice_t *pVoice = VoiceAlloc_allocate();
+        if (!pVoice) {
+            // Every slot is busy fading out. Count rather than print: this is the real-time thread.
+            atomic_fetch_add(&s_voiceOverflowCount, 1);
+            if (trigger.pKit) {
+                atomic_fetch_sub_explicit(&trigger.pKit->activeVoices, 1, memory_order_release);
             }
+            continue;
+        }
+
+        pVoice->pSound = trigger.pSound;
+        pVoice->location = 0; // Start playing from the beginning
+        pVoice->stepQ16 = trigger.stepQ16;
+        pVoice->gainLeftQ15 = trigger.gainLeftQ15;
+        pVoice->gainRightQ15 = trigger.gainRightQ15;
+        pVoice->chokeGroup = trigger.chokeGroup;
+        pVoice->pKit = pVoiceKit;
+        if (pVoiceKit && !trigger.pKit) {
+            atomic_fetch_add_explicit(&pVoiceKit->activeVoices, 1, memory_order_relaxed);
+        }
+        Trace_event(TRACE_VOICE_START, trigger.pKit ? -1 : trigger.soundId, (int)pVoice->serial);
+
+        if (startDelay > 0) {
+            pVoice->location = -startDelay;
+        } else if (trigger.startFrame == AUDIOMIXER_FRAME_NOW
+                && (s_bufferTriggerNs == 0 || trigger.queuedNs < s_bufferTriggerNs)) {
+            s_bufferTriggerNs = trigger.queuedNs; // Oldest immediate trigger in this buffer
+        }
 
-            // Get sample, scale by volume
-            long sampleData = (long)(sound->pData[location + j] * volMultiplier);
-            
-            // Add to existing buffer value (MIXING happening here)
-            long sample = buff[j] + sampleData;
-
-            // CLIPPING: Ensure we don't overflow the 16-bit integer limits.
-            // If we exceed 32767, cap it there. Otherwise, audio wraps around and sounds terrible.
-            if (sample > SHRT_MAX) sample = SHRT_MAX;
-            else if (sample < SHRT_MIN) sample = SHRT_MIN;
-            
-            buff[j] = (short)sample;
+        // Cut off the rest of its choke group right where this voice starts
+        // (pinned voices only take part in explicit chokes)
+        if (!trigger.pKit) {
+            VoiceAlloc_choke(pVoice->chokeGroup, startDelay, pVoice);
         }
+    }
+}
+
+// Publish the frame clock / wall time pair for AudioMixer_getFrameClock().
+static void updateClockAnchor(unsigned long long frame)
+{
+    unsigned int seq = atomic_load_explicit(&s_anchorSeq, memory_order_relaxed);
+    atomic_store_explicit(&s_anchorSeq, seq + 1, memory_order_relaxed); // Odd: write in progress
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&s_anchorFrame, frame, memory_order_relaxed);
+    atomic_store_explicit(&s_anchorNs, nowNs(), memory_order_relaxed);
+    atomic_store_explicit(&s_anchorSeq, seq + 2, memory_order_release);
+}
 
-        // Update the playback head (location) for this sound if it didn't finish
-        if (localSoundBites[i].pSound != NULL) {
-            pthread_mutex_lock(&audioMutex);
-            // Re-check pSound in case it was cancelled externally (race condition safety)
-            if (soundBites[i].pSound != NULL) {
-                soundBites[i].location += size;
+// Convert the 0-100 software volume into a Q15 gain for the mix kernel.
+static int32_t volumeToGainQ15(int vol)
+{
+    return (int32_t)vol * MIXKERNEL_UNITY_Q15 / AUDIOMIXER_MAX_VOLUME;
+}
+
+// Mix a voice that is being cut off (stolen or choked): full gain until its release
+// delay runs out, then a linear fade in short steps. Returns true once the fade is done.
+static bool mixRelease(int32_t *pAcc, const int16_t *pSrc, int count, int32_t gainL, int32_t gainR,
+                       mixerVoice_t *pVoice)
+{
+    int i = (count < pVoice->releaseDelay) ? count : pVoice->releaseDelay;
+    if (i > 0) {
+        MixKernel_accumulateStereo(pAcc, pSrc, i, gainL, gainR);
+        pVoice->releaseDelay -= i;
+    }
+    while (i < count && pVoice->releaseFrames > 0) {
+        int n = count - i;
+        if (n > VOICEALLOC_RELEASE_STEP_FRAMES) n = VOICEALLOC_RELEASE_STEP_FRAMES;
+        if (n > pVoice->releaseFrames) n = pVoice->releaseFrames;
+        int32_t scaleQ15 = pVoice->releaseFrames * MIXKERNEL_UNITY_Q15 / VOICEALLOC_RELEASE_FRAMES;
+        MixKernel_accumulateStereo(pAcc + i * OUTPUT_CHANNELS, pSrc + i, n,
+                                   (gainL * scaleQ15) >> 15, (gainR * scaleQ15) >> 15);
+        pVoice->releaseFrames -= n;
+        i += n;
+    }
+    return pVoice->releaseFrames == 0;
+}
+
+// Add 'count' frames of a voice to the accumulator, fading it if it was released.
+// Returns true if a release fade finished.
+static bool accumulateVoice(int32_t *pAcc, const int16_t *pSrc, int count, int32_t gainL, int32_t gainR,
+                            mixerVoice_t *pVoice)
+{
+    if (count <= 0) {
+        return false;
+    }
+    if (pVoice->released) {
+        return mixRelease(pAcc, pSrc, count, gainL, gainR, pVoice);
+    }
+    MixKernel_accumulateStereo(pAcc, pSrc, count, gainL, gainR);
+    return false;
+}
+
+// Mix the next 'space' frames of a voice into a lane's accumulator at frame 'offset'.
+// Returns true when the voice has reached the end of its sound.
+static bool mixVoice(mixerVoice_t *pVoice, renderLane_t *pLane, int offset, int space, int32_t masterQ15)
+{
+    wavedata_t *sound = pVoice->pSound;
+    int location = pVoice->location;
+    int remaining = sound->numSamples - location;
+    int32_t *pAcc = pLane->pAcc + offset * OUTPUT_CHANNELS;
+    int32_t gainL = (pVoice->gainLeftQ15 * masterQ15) >> 15;
+    int32_t gainR = (pVoice->gainRightQ15 * masterQ15) >> 15;
+
+    if (pVoice->stepQ16 == PITCH_UNITY_Q16) {
+        // Original pitch: mix straight from the sample data.
+        // Only mix what is left of this clip; one bounds check per voice, not per sample
+        int count = (remaining < space) ? remaining : space;
+        bool faded = accumulateVoice(pAcc, sound->pData + location, count, gainL, gainR, pVoice);
+        pVoice->location = location + space;
+        return faded || remaining <= space;
+    }
+
+    // Pitched: resample this block into scratch first, then mix that
+    int count = MixKernel_interpolate(pLane->pPitch, space, sound->pData + location, remaining,
+                                      pVoice->fracQ16, pVoice->stepQ16);
+    bool faded = accumulateVoice(pAcc, pLane->pPitch, count, gainL, gainR, pVoice);
+    uint64_t advance = pVoice->fracQ16 + (uint64_t)count * pVoice->stepQ16;
+    pVoice->location = location + (int)(advance >> 16);
+    pVoice->fracQ16 = (uint32_t)(advance & 0xFFFF);
+    return faded || count < space || pVoice->location >= sound->numSamples;
+}
+
+// Render every numWorkers-th voice of the work list (starting at 'worker') into
+// that worker's lane. Each voice belongs to exactly one worker, so its state
+// needs no locking.
+static void renderJob(int worker, int numWorkers, void *pArg)
+{
+    (void)pArg;
+    renderLane_t *pLane = &s_lanes[worker];
+    int size = s_renderFrames;
+
+    // Start with silence (0)
+    MixKernel_clear(pLane->pAcc, size * OUTPUT_CHANNELS);
+    pLane->mixedAny = false;
+
+    for (int k = worker; k < s_numActiveVoices; k += numWorkers) {
+        mixerVoice_t *pVoice = s_activeVoices[k];
+
+        // Scheduled voice: skip ahead to its start frame within this buffer
+        int offset = 0;
+        if (pVoice->location < 0) {
+            if (-pVoice->location >= size) {
+                pVoice->location += size; // Starts in a later buffer
+                continue;
             }
-            pthread_mutex_unlock(&audioMutex);
+            offset = -pVoice->location;
+            pVoice->location = 0;
+        }
+
+        pLane->mixedAny = true;
+
+        // Advance the playback head, or free the slot if the clip has ended
+        if (mixVoice(pVoice, pLane, offset, size - offset, s_renderMasterQ15)) {
+            Trace_event(TRACE_VOICE_END, (int)pVoice->serial, 0);
+            VoiceAlloc_end(pVoice);
         }
     }
 }
 
+// This function fills the buffer with the next chunk of audio.
+// It adds every active sound into a 32-bit stereo accumulator (with its gain, pan
+// and the volume), then clips the result to fit in 16-bit shorts in a single pass.
+// Returns true if any voice was mixed into this buffer.
+static bool fillPlaybackBuffer(short *buff, int size)
+{
+    PROBE_SCOPE("render");
+    unsigned long long bufferStartFrame = atomic_load_explicit(&s_frameClock, memory_order_relaxed);
+    updateClockAnchor(bufferStartFrame);
+
+    // Pick up any new sounds queued by the control threads
+    drainTriggerQueue(bufferStartFrame);
+
+    // Idle fast path. Triggers were drained above as usual, so a hit that arrives
+    // while idle starts in this very buffer: idling adds no latency to it.
+    if (VoiceAlloc_getNumActive() == 0) {
+        if (!s_bufferSilent) {
+            memset(buff, 0, (size_t)size * OUTPUT_CHANNELS * sizeof(short));
+            s_bufferSilent = true;
+        }
+        atomic_store_explicit(&s_idle, true, memory_order_relaxed);
+        atomic_store_explicit(&s_frameClock, bufferStartFrame + (unsigned long long)size, memory_order_relaxed);
+        return false;
+    }
+    s_bufferSilent = false;
+    atomic_store_explicit(&s_idle, false, memory_order_relaxed);
+
+    // List the voices to render this period
+    s_numActiveVoices = VoiceAlloc_getNumActive();
+    for (int k = 0; k < s_numActiveVoices; k++) {
+        s_activeVoices[k] = VoiceAlloc_getActive(k);
+    }
+    s_renderFrames = size;
+    s_renderMasterQ15 = volumeToGainQ15(atomic_load(&volume));
+
+    // Mix each active sound, split across the render pool when there are enough
+    int numWorkers = (s_numActiveVoices >= PARALLEL_MIN_VOICES) ? RenderPool_getNumWorkers() : 1;
+    if (numWorkers > s_numActiveVoices) numWorkers = s_numActiveVoices;
+    RenderPool_run(numWorkers, NULL);
+
+    // Sum the lanes in worker order (deterministic)
+    bool mixedAny = s_lanes[0].mixedAny;
+    for (int w = 1; w < numWorkers; w++) {
+        MixKernel_add(s_lanes[0].pAcc, s_lanes[w].pAcc, size * OUTPUT_CHANNELS);
+        mixedAny |= s_lanes[w].mixedAny;
+    }
+
+    // CLIPPING: Saturate to the 16-bit range once, after all voices are summed.
+    // Otherwise, audio wraps around and sounds terrible.
+    MixKernel_saturate(buff, s_lanes[0].pAcc, size * OUTPUT_CHANNELS);
+
+    // Give the slots of voices that ended back to the allocator
+    VoiceAlloc_collect();
+
+    atomic_store_explicit(&s_frameClock, bufferStartFrame + (unsigned long long)size, memory_order_relaxed);
+    return mixedAny;
+}
+
+static void recordTriggerLatency(long long queuedNs)
+{
+    long delay = s_pOutput->getDelay ? s_pOutput->getDelay() : -1;
+    if (delay < 0) {
+        return; // No playback clock (e.g. a file rendered faster than real time)
+    }
+    long ahead = delay - (long)playbackBufferSize;
+    if (ahead < 0) ahead = 0;
+    long long heardNs = nowNs() + (long long)ahead * NS_PER_SECOND / SAMPLE_RATE;
+    Interval_record(INTERVAL_LATENCY, (heardNs - queuedNs) / 1000000.0);
+}
+
+// Stats: how much of the period the render took (DSP load). Anything at or over
+// 100% means the period was late and the output leaned on its buffering.
+static void recordRenderTime(long long renderNs)
+{
+    long long periodNs = playbackBufferSize * NS_PER_SECOND / SAMPLE_RATE;
+    long long percent = renderNs * 100 / periodNs;
+    int bucket = (percent >= 100) ? AUDIOMIXER_LOAD_BUCKETS - 1 : (int)(percent / 10);
+
+    atomic_fetch_add_explicit(&s_loadHistogram[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_periodCount, 1, memory_order_relaxed);
+    if (renderNs > atomic_load_explicit(&s_worstRenderNs, memory_order_relaxed)) {
+        atomic_store_explicit(&s_worstRenderNs, renderNs, memory_order_relaxed);
+    }
+    Interval_record(INTERVAL_DSP_LOAD, (double)renderNs * 100.0 / (double)periodNs);
+}
+
+// Stats: timestamp under-runs the output reported during the last write.
+static void checkXruns(void)
+{
+    if (!s_pOutput->getXrunStats) {
+        return;
+    }
+    unsigned long xruns, failures;
+    s_pOutput->getXrunStats(&xruns, &failures);
+    if (xruns != s_lastXruns) {
+        s_lastXruns = xruns;
+        Trace_event(TRACE_XRUN, (int)xruns, (int)failures);
+        atomic_store_explicit(&s_lastXrunNs, nowNs(), memory_order_relaxed);
+    }
+}
+
 void* playbackThread(void* _arg)
 {
 	(void)_arg;
+	RtProfile_applyToCurrentThread(RT_ROLE_AUDIO, "audio");
 
 	while (!stopping) {
 		Interval_mark(INTERVAL_AUDIO); // Stats: record buffer fill interval
 		
         // 1. Generate the audio data
-		fillPlaybackBuffer(playbackBuffer, playbackBufferSize);
+        long long renderStartNs = nowNs();
+        Trace_event(TRACE_RENDER_BEGIN, 0, 0);
+		bool audible = fillPlaybackBuffer(playbackBuffer, playbackBufferSize);
+        Trace_event(TRACE_RENDER_END, audible, VoiceAlloc_getNumActive());
+        recordRenderTime(nowNs() - renderStartNs);
+
+        // 2. Send it to the output (blocks until the device has room)
+		long frames = s_pOutput->write(playbackBuffer, playbackBufferSize);
+        Trace_event(TRACE_PCM_WRITE, (int)frames, (int)playbackBufferSize);
+        checkXruns();
+
+        // Stats: remember when the first sound left the mixer (startup latency)
+        if (audible && atomic_load_explicit(&s_firstSoundNs, memory_order_relaxed) == 0) {
+            atomic_store(&s_firstSoundNs, nowNs());
+        }
 
-        // 2. Send it to the sound card
-		snd_pcm_sframes_t frames = snd_pcm_writei(handle,
-				playbackBuffer, playbackBufferSize);
+        // Stats: trigger-to-DAC latency. Once the write returns, 'delay' frames are
+        // queued ahead of the DAC, the last 'playbackBufferSize' of them ours, so the
+        // buffer's first frame is heard (delay - size) frames from now.
+        if (s_bufferTriggerNs != 0) {
+            recordTriggerLatency(s_bufferTriggerNs);
+            s_bufferTriggerNs = 0;
+        }
 
-        // 3. Error Handling
-		if (frames < 0) {
-            // Recover from under-runs (when we aren't generating audio fast enough)
-			frames = snd_pcm_recover(handle, frames, 1);
-		}
+        // 3. Error Handling (backends recover from under-runs themselves)
 		if (frames < 0) {
-			fprintf(stderr, "ERROR: Failed writing audio with snd_pcm_writei(): %li\n", frames);
+            LOG_LIMITED(LOG_LEVEL_ERROR, "ERROR: Failed writing audio to '%s' output: %li", s_pOutput->name, frames);
 		}
 	}
 
@@ -2,27 +2,159 @@
 #define AUDIOMIXER_H
 
 #include <stdbool.h>
+#include "audioOutput.h"
+#include "sampleConvert.h"
 
 #define AUDIOMIXER_MAX_VOLUME 100
+#define AUDIOMIXER_SAMPLE_RATE 44100
+
+// Start frame meaning "as soon as possible" (the next buffer rendered)
+#define AUDIOMIXER_FRAME_NOW 0ULL
+
+// Output is interleaved stereo; samples are stored mono and panned per voice
+#define AUDIOMIXER_OUTPUT_CHANNELS 2
+
+// Pitch (playback rate) range accepted per voice
+#define AUDIOMIXER_MIN_PITCH 0.25f
+#define AUDIOMIXER_MAX_PITCH 4.0f
+
+#include <stddef.h>
+#include <stdatomic.h>
 
 // Data structure to hold raw PCM audio in memory
 typedef struct {
 	int numSamples;
 	short *pData; // Array of 16-bit samples
+
+	// When non-NULL, pData points into this read-only file mapping (zero-copy load)
+	// instead of a malloc'd buffer.
+	void *pMapping;
+	size_t mappingSize;
 } wavedata_t;
 
-// Initialize the ALSA playback system and mixing thread
-void AudioMixer_init(void);
+// A set of sounds addressed by ID (the sample bank publishes one per drum kit).
+// Sounds queued by ID are resolved against the current kit on the playback thread,
+// so a kit can be replaced while it is playing.
+typedef struct {
+	int numSounds;
+	wavedata_t *pSounds;
+	atomic_int activeVoices; // Voices playing from this kit (written by the playback thread)
+} audioKit_t;
+
+// How a single voice is played. Out-of-range values are clamped.
+typedef struct {
+	float gain;  // 0.0 .. 1.0 (e.g. hit velocity)
+	float pan;   // -1.0 hard left .. 0.0 centre .. +1.0 hard right (constant-power law)
+	float pitch; // Playback rate: 1.0 = original, 2.0 = an octave up (linear interpolation)
+	int chokeGroup; // 0 = none; starting a voice fades out the playing voices of its group
+} audioVoiceParams_t;
+
+// Unity gain, centre pan, original pitch, no choke group
+#define AUDIOMIXER_VOICE_DEFAULTS { 1.0f, 0.0f, 1.0f, 0 }
+
+// Initialize the audio output and mixing thread.
+// Pass NULL to play through the default ALSA device. If the requested output cannot
+// be opened, the mixer falls back to a real-time null sink so playback logic still runs.
+void AudioMixer_init(const AudioOutputConfig *pOutputConfig);
 void AudioMixer_cleanup(void);
 
-// Helper to load a WAV file from disk into a wavedata_t struct
+// Helper to load a WAV file from disk into a wavedata_t struct.
+// The RIFF chunks are parsed properly; files already in the engine format
+// (mono 16-bit PCM at AUDIOMIXER_SAMPLE_RATE) are memory-mapped, not copied.
+// Anything else (stereo, 8/24/32-bit, float, other rates) is converted here.
 _Bool AudioMixer_readWaveFileIntoMemory(char *fileName, wavedata_t *pSound);
 void AudioMixer_freeWaveFileData(wavedata_t *pSound);
 
+// Number of threads that render voices (1 = the playback thread alone, the default).
+// With more, busy periods are split across a pool of render threads. Call before AudioMixer_init().
+void AudioMixer_setRenderThreads(int numThreads);
+
+// Offline benchmark of the voice renderer with 1 .. maxThreads render threads and
+// increasing voice counts; prints average/worst render time per period and how many
+// voices each core sustains in real time. Call instead of AudioMixer_init().
+// Returns 0 if every thread count produced output identical to the serial render.
+int AudioMixer_runRenderBenchmark(int maxThreads);
+
+// Resampler used by later loads of files at other sample rates (default: sinc).
+void AudioMixer_setResampleQuality(ResampleQuality quality);
+ResampleQuality AudioMixer_getResampleQuality(void);
+
 // Request a sound to be played.
 // This adds the sound to the mixer queue. It will be mixed with any currently playing sounds.
+// Lock-free and non-blocking: safe to call from any thread at any rate.
 void AudioMixer_queueSound(wavedata_t *pSound);
 
+// Make 'pKit' the kit that AudioMixer_queueKitSoundAt() IDs refer to. Never blocks;
+// voices already playing from the previous kit play out. Pass NULL to detach.
+void AudioMixer_setKit(audioKit_t *pKit);
+
+// True once the playback thread has let go of 'pKit': it is no longer current,
+// the playback thread has seen that, and no voice is still playing from it.
+// A replaced kit may be freed only after this returns true.
+bool AudioMixer_isKitIdle(audioKit_t *pKit);
+
+// Queue sound 'soundId' of the current kit (resolved when the mixer picks the trigger
+// up; IDs the kit does not have are ignored). Same timing rules as AudioMixer_queueSoundAt.
+// 'pParams' may be NULL for AUDIOMIXER_VOICE_DEFAULTS.
+void AudioMixer_queueKitSoundAt(int soundId, unsigned long long startFrame,
+                                const audioVoiceParams_t *pParams);
+
+// Request a sound to start on an exact frame of the mixer's frame clock
+// (see AudioMixer_getFrameClock). The voice starts at that sample offset inside
+// whichever buffer contains the frame. Frames already rendered start immediately.
+void AudioMixer_queueSoundAt(wavedata_t *pSound, unsigned long long startFrame,
+                             const audioVoiceParams_t *pParams);
+
+// Queue sound 'soundId' of 'pKit', a set of sounds that need not be the current kit
+// (e.g. pre-mixed pattern loops). It plays at unity gain on both sides and original
+// pitch: the caller has already mixed and panned it. The kit's activeVoices count
+// covers the trigger from this call until the voice ends, so AudioMixer_isKitIdle(pKit)
+// only turns true once it has played out. 'chokeGroup' only lets AudioMixer_chokeAt
+// cut the voice short; starting it chokes nothing.
+void AudioMixer_queuePinnedSoundAt(audioKit_t *pKit, int soundId, unsigned long long startFrame,
+                                   int chokeGroup);
+
+// Fade out every voice of 'chokeGroup' that has started by 'frame' (see
+// audioVoiceParams_t), as if a new voice of the group started on that frame.
+void AudioMixer_chokeAt(int chokeGroup, unsigned long long frame);
+
+// Current position of the mixer's running frame clock: frames rendered since
+// AudioMixer_init(), interpolated to "now" from the start of the latest render.
+// Schedule triggers at least one period ahead of this to get exact placement.
+unsigned long long AudioMixer_getFrameClock(void);
+
+// Number of triggers dropped so far, either because the trigger ring was full
+// or because every voice slot was busy when the mixer picked the trigger up.
+// Either pointer may be NULL.
+void AudioMixer_getDropStats(unsigned long *pQueueFull, unsigned long *pNoFreeVoice);
+
+// DSP load histogram: render time of each period as a share of the period, in 10%
+// buckets. The last bucket counts periods that took longer to render than to play
+// (missed deadlines).
+#define AUDIOMIXER_LOAD_BUCKETS 11
+
+// Playback thread telemetry since AudioMixer_init.
+typedef struct {
+    unsigned long periods;            // Periods rendered
+    unsigned long loadHistogram[AUDIOMIXER_LOAD_BUCKETS];
+    double peakLoad;                  // Worst render time / period length
+    unsigned long xruns;              // Output under-runs
+    unsigned long xrunFailures;       // Under-runs the output could not recover from
+    long long lastXrunNs;             // CLOCK_MONOTONIC time of the latest under-run (0 = none)
+    unsigned long queueDrops;         // Triggers lost to a full trigger ring
+    unsigned long voiceDrops;         // Triggers lost for want of a voice
+} audioMixerStats_t;
+
+void AudioMixer_getStats(audioMixerStats_t *pStats);
+
+// True while the last period had nothing to play (no voice sounding or scheduled).
+// Such periods are written out as silence without being mixed.
+bool AudioMixer_isIdle(void);
+
+// CLOCK_MONOTONIC time (ns) at which the first buffer containing a sound was handed
+// to the output, or 0 if nothing has played yet. Used to report startup latency.
+long long AudioMixer_getFirstSoundNs(void);
+
 // Get/Set global volume (0 - 100)
 void AudioMixer_setVolume(int newVolume);
 int AudioMixer_getVolume();
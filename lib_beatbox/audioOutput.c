@@ -0,0 +1,112 @@
+/*
+ * Audio Output Module
+ * * Selects where the mixer's audio goes. The mixer only ever talks to an
+ * AudioOutputBackend, so the full mixing pipeline can run against a sound card,
+ * a .wav file, or nothing at all (for profiling on hosts with no audio hardware).
+ * * Also provides a small pacing helper so the file/null sinks can mimic the
+ * timing of a real device, or run as fast as the CPU allows.
+ */
+
+#include "audioOutput.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+// --- Configuration Constants ---
+
+#define NS_PER_SECOND 1000000000LL
+
+// --- Public API ---
+
+void AudioOutput_getDefaultConfig(AudioOutputConfig *pConfig)
+{
+    memset(pConfig, 0, sizeof(*pConfig));
+    pConfig->type = AUDIO_OUTPUT_ALSA;
+    pConfig->device = NULL;
+    pConfig->wavPath = NULL;
+    pConfig->realTime = true;
+    pConfig->periodFrames = AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES;
+    pConfig->periodCount = AUDIOOUTPUT_DEFAULT_PERIOD_COUNT;
+}
+
+bool AudioOutput_parseSpec(const char *spec, AudioOutputConfig *pConfig)
+{
+    if (strcmp(spec, "alsa") == 0) {
+        pConfig->type = AUDIO_OUTPUT_ALSA;
+        pConfig->device = NULL;
+        return true;
+    }
+    if (strncmp(spec, "alsa:", 5) == 0 && spec[5] != '\0') {
+        pConfig->type = AUDIO_OUTPUT_ALSA;
+        pConfig->device = spec + 5;
+        return true;
+    }
+    if (strncmp(spec, "wav:", 4) == 0 && spec[4] != '\0') {
+        pConfig->type = AUDIO_OUTPUT_WAV;
+        pConfig->wavPath = spec + 4;
+        return true;
+    }
+    if (strcmp(spec, "null") == 0) {
+        pConfig->type = AUDIO_OUTPUT_NULL;
+        return true;
+    }
+    return false;
+}
+
+const AudioOutputBackend* AudioOutput_getBackend(AudioOutputType type)
+{
+    switch (type) {
+        case AUDIO_OUTPUT_ALSA: return AudioOutputAlsa_getBackend();
+        case AUDIO_OUTPUT_WAV:  return AudioOutputWav_getBackend();
+        case AUDIO_OUTPUT_NULL: return AudioOutputNull_getBackend();
+    }
+    return NULL;
+}
+
+// --- Pacing Helper ---
+
+void AudioOutput_pacerStart(AudioOutputPacer *pPacer, unsigned int sampleRate, bool realTime)
+{
+    clock_gettime(CLOCK_MONOTONIC, &pPacer->epoch);
+    pPacer->framesWritten = 0;
+    pPacer->sampleRate = sampleRate;
+    pPacer->realTime = realTime;
+}
+
+void AudioOutput_pacerWait(AudioOutputPacer *pPacer, unsigned long numFrames)
+{
+    if (pPacer->realTime && pPacer->sampleRate > 0) {
+        // Deadline = epoch + (frames already handed over) / rate.
+        // Sleeping to an absolute time keeps the clock from drifting.
+        // (Split into whole seconds and the rest so frames * 1e9 cannot overflow.)
+        unsigned long long rate = pPacer->sampleRate;
+        long long offsetNs = (long long)((pPacer->framesWritten / rate) * NS_PER_SECOND
+                                         + (pPacer->framesWritten % rate) * NS_PER_SECOND / rate);
+        long long deadlineNs = pPacer->epoch.tv_nsec + offsetNs;
+
+        struct timespec deadline;
+        deadline.tv_sec = pPacer->epoch.tv_sec + (time_t)(deadlineNs / NS_PER_SECOND);
+        deadline.tv_nsec = (long)(deadlineNs % NS_PER_SECOND);
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+            // Interrupted by a signal: keep waiting for the same deadline
+        }
+    }
+    pPacer->framesWritten += numFrames;
+}
+
+long AudioOutput_pacerDelay(const AudioOutputPacer *pPacer)
+{
+    if (!pPacer->realTime || pPacer->sampleRate == 0) {
+        return -1;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long elapsedNs = (now.tv_sec - pPacer->epoch.tv_sec) * NS_PER_SECOND
+                        + (now.tv_nsec - pPacer->epoch.tv_nsec);
+    long long rate = pPacer->sampleRate;
+    long long played = (elapsedNs / NS_PER_SECOND) * rate
+                     + (elapsedNs % NS_PER_SECOND) * rate / NS_PER_SECOND;
+    long long pending = (long long)pPacer->framesWritten - played;
+    return (pending > 0) ? (long)pending : 0;
+}
@@ -0,0 +1,93 @@
+#ifndef AUDIOOUTPUT_H
+#define AUDIOOUTPUT_H
+
+#include <stdbool.h>
+#include <time.h>
+
+// Default period geometry: 4 x 512 frames (~46 ms of buffering at 44.1 kHz)
+#define AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES 512
+#define AUDIOOUTPUT_DEFAULT_PERIOD_COUNT  4
+
+// Low-latency preset: 2 x 128 frames (~5.8 ms of buffering at 44.1 kHz)
+#define AUDIOOUTPUT_LOW_LATENCY_PERIOD_FRAMES 128
+#define AUDIOOUTPUT_LOW_LATENCY_PERIOD_COUNT  2
+
+// Where the mixed audio goes.
+typedef enum {
+    AUDIO_OUTPUT_ALSA = 0, // Real sound card via libasound
+    AUDIO_OUTPUT_WAV,      // 16-bit PCM .wav file on disk
+    AUDIO_OUTPUT_NULL      // Discard everything (free-running clock only)
+} AudioOutputType;
+
+// Options handed to a backend when it is opened.
+typedef struct {
+    AudioOutputType type;
+    const char *device;      // ALSA PCM device name (NULL = default dongle)
+    const char *wavPath;     // Output file for AUDIO_OUTPUT_WAV
+    bool realTime;           // WAV/null: pace writes to the sample clock (false = as fast as possible)
+    unsigned long periodFrames; // Frames rendered per write (ALSA may round to what the hardware allows)
+    unsigned int periodCount;   // ALSA: periods in the device buffer (total buffering = size x count)
+    unsigned int sampleRate; // Filled in by the mixer
+    unsigned int channels;   // Filled in by the mixer
+} AudioOutputConfig;
+
+// Interface every output backend implements.
+// All calls are made from the mixer: open/close from init/cleanup, write from the playback thread.
+typedef struct {
+    const char *name;
+
+    // Open the sink. On success returns 0 and sets *pPeriodFrames to the number of
+    // frames the mixer should render per write. Returns a negative value on failure.
+    int (*open)(const AudioOutputConfig *pConfig, unsigned long *pPeriodFrames);
+
+    // Write interleaved 16-bit frames. Blocks (or sleeps) as a sound card would.
+    // Returns frames written, or a negative error code if the write could not be recovered.
+    long (*write)(const short *pFrames, unsigned long numFrames);
+
+    // Flush anything pending and release the sink.
+    void (*close)(void);
+
+    // Frames written but not yet played: a frame written now reaches the DAC after
+    // this many frames. Returns -1 if the sink has no playback clock.
+    long (*getDelay)(void);
+
+    // Under-runs so far, and how many of them could not be recovered. Safe to call
+    // from any thread. NULL for sinks that cannot under-run.
+    void (*getXrunStats)(unsigned long *pXruns, unsigned long *pFailures);
+} AudioOutputBackend;
+
+// Fill *pConfig with the defaults (ALSA on the USB dongle, real-time pacing).
+void AudioOutput_getDefaultConfig(AudioOutputConfig *pConfig);
+
+// Parse an output spec of the form "alsa[:device]", "wav:<path>" or "null".
+// Returns false if the spec is not recognized. Strings point into 'spec'.
+bool AudioOutput_parseSpec(const char *spec, AudioOutputConfig *pConfig);
+
+// Look up the backend for an output type.
+const AudioOutputBackend* AudioOutput_getBackend(AudioOutputType type);
+
+// --- Pacing helper for backends without a hardware clock ---
+
+typedef struct {
+    struct timespec epoch;            // Time the first frame was written
+    unsigned long long framesWritten; // Frames written since the epoch
+    unsigned int sampleRate;
+    bool realTime;
+} AudioOutputPacer;
+
+void AudioOutput_pacerStart(AudioOutputPacer *pPacer, unsigned int sampleRate, bool realTime);
+
+// Account for 'numFrames' frames and, in real-time mode, sleep until the moment
+// a sound card would have consumed everything written before them.
+void AudioOutput_pacerWait(AudioOutputPacer *pPacer, unsigned long numFrames);
+
+// Frames handed over but not yet "played" by the simulated device (-1 when not real-time).
+long AudioOutput_pacerDelay(const AudioOutputPacer *pPacer);
+
+// --- Backend implementations ---
+
+const AudioOutputBackend* AudioOutputAlsa_getBackend(void);
+const AudioOutputBackend* AudioOutputWav_getBackend(void);
+const AudioOutputBackend* AudioOutputNull_getBackend(void);
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * ALSA Audio Output Backend
+ * * Plays the mixer's output on a real sound card through libasound.
+ * Assumes the hardware is plugged in as 'plughw:1,0' (typical for USB audio on BeagleBone)
+ * unless another device name is given.
+ * * The device buffer is configured as an explicit number of periods of an explicit
+ * size (see AudioOutputConfig), and the mixer renders one period per write, so the
+ * output latency is bounded by period size x period count.
+ */
+
+#include "audioOutput.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <alsa/asoundlib.h>
+
+// --- Configuration Constants ---
+
+#define ALSA_PCM_DEVICE "plughw:1,0"
+
+// --- Internal State ---
+
+static snd_pcm_t *s_handle = NULL;
+
+// Under-run counters (written by the playback thread, read by the stats)
+static atomic_ulong s_xruns = 0;
+static atomic_ulong s_xrunFailures = 0;
+
+// --- Backend Implementation ---
+
+// Log an ALSA error and report whether 'err' is a failure.
+static bool failed(int err, const char *what)
+{
+    if (err < 0) {
+        printf("AudioOutput: %s error: %s\n", what, snd_strerror(err));
+        return true;
+    }
+    return false;
+}
+
+// Hardware parameters: 16-bit Little Endian, interleaved, with an explicit period
+// size and count so the total buffering (and so the output latency) is known.
+static int setHwParams(const AudioOutputConfig *pConfig, snd_pcm_uframes_t *pPeriod, unsigned int *pPeriods)
+{
+    snd_pcm_hw_params_t *params;
+    snd_pcm_hw_params_alloca(&params);
+
+    unsigned int rate = pConfig->sampleRate;
+    *pPeriod = pConfig->periodFrames ? pConfig->periodFrames : AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES;
+    *pPeriods = pConfig->periodCount ? pConfig->periodCount : AUDIOOUTPUT_DEFAULT_PERIOD_COUNT;
+    int dir = 0;
+
+    int err;
+    if (failed(err = snd_pcm_hw_params_any(s_handle, params), "Playback hw params")) return err;
+    if (failed(err = snd_pcm_hw_params_set_rate_resample(s_handle, params, 1), "Resampling")) return err;
+    if (failed(err = snd_pcm_hw_params_set_access(s_handle, params, SND_PCM_ACCESS_RW_INTERLEAVED), "Access type")) return err;
+    if (failed(err = snd_pcm_hw_params_set_format(s_handle, params, SND_PCM_FORMAT_S16_LE), "Sample format")) return err;
+    if (failed(err = snd_pcm_hw_params_set_channels(s_handle, params, pConfig->channels), "Channel count")) return err;
+    if (failed(err = snd_pcm_hw_params_set_rate_near(s_handle, params, &rate, &dir), "Sample rate")) return err;
+    if (failed(err = snd_pcm_hw_params_set_period_size_near(s_handle, params, pPeriod, &dir), "Period size")) return err;
+    if (failed(err = snd_pcm_hw_params_set_periods_near(s_handle, params, pPeriods, &dir), "Period count")) return err;
+    if (failed(err = snd_pcm_hw_params(s_handle, params), "Playback set hw params")) return err;
+
+    // The hardware may have rounded our request; use what it actually chose
+    snd_pcm_hw_params_get_period_size(params, pPeriod, &dir);
+    snd_pcm_hw_params_get_periods(params, pPeriods, &dir);
+    if (rate != pConfig->sampleRate) {
+        printf("AudioOutput: WARNING: Device runs at %u Hz instead of %u Hz.\n", rate, pConfig->sampleRate);
+    }
+    return 0;
+}
+
+// Software parameters: start playing once the buffer is full, and wake the
+// writer as soon as one period is free.
+static int setSwParams(snd_pcm_uframes_t period, unsigned int periods)
+{
+    snd_pcm_sw_params_t *params;
+    snd_pcm_sw_params_alloca(&params);
+
+    int err;
+    if (failed(err = snd_pcm_sw_params_current(s_handle, params), "Playback sw params")) return err;
+    if (failed(err = snd_pcm_sw_params_set_start_threshold(s_handle, params, period * periods), "Start threshold")) return err;
+    if (failed(err = snd_pcm_sw_params_set_avail_min(s_handle, params, period), "Avail min")) return err;
+    if (failed(err = snd_pcm_sw_params(s_handle, params), "Playback set sw params")) return err;
+    return 0;
+}
+
+static int alsaOpen(const AudioOutputConfig *pConfig, unsigned long *pPeriodFrames)
+{
+    const char *device = pConfig->device ? pConfig->device : ALSA_PCM_DEVICE;
+
+    // Open the PCM device
+    int err = snd_pcm_open(&s_handle, device, SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        printf("AudioOutput: Playback open error on %s: %s\n", device, snd_strerror(err));
+        s_handle = NULL;
+        return err;
+    }
+
+    snd_pcm_uframes_t period = 0;
+    unsigned int periods = 0;
+    err = setHwParams(pConfig, &period, &periods);
+    if (err == 0) {
+        err = setSwParams(period, periods);
+    }
+    if (err < 0) {
+        snd_pcm_close(s_handle);
+        s_handle = NULL;
+        return err;
+    }
+
+    // Render exactly one period per write
+    printf("AudioOutput: ALSA %s: %lu frames x %u periods (%.1f ms buffer).\n",
+           device, (unsigned long)period, periods, period * periods * 1000.0 / pConfig->sampleRate);
+    *pPeriodFrames = period;
+    return 0;
+}
+
+static long alsaWrite(const short *pFrames, unsigned long numFrames)
+{
+    snd_pcm_sframes_t frames = snd_pcm_writei(s_handle, pFrames, numFrames);
+    if (frames < 0) {
+        // Recover from under-runs (when we aren't generating audio fast enough)
+        bool xrun = (frames == -EPIPE || frames == -ESTRPIPE);
+        if (xrun) {
+            atomic_fetch_add_explicit(&s_xruns, 1, memory_order_relaxed);
+        }
+        frames = snd_pcm_recover(s_handle, (int)frames, 1);
+        if (xrun && frames < 0) {
+            atomic_fetch_add_explicit(&s_xrunFailures, 1, memory_order_relaxed);
+        }
+    }
+    return frames;
+}
+
+static void alsaClose(void)
+{
+    if (s_handle) {
+        snd_pcm_drain(s_handle);
+        snd_pcm_close(s_handle);
+        s_handle = NULL;
+    }
+}
+
+static long alsaGetDelay(void)
+{
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(s_handle, &delay) < 0) {
+        return -1;
+    }
+    return (long)delay;
+}
+
+static void alsaGetXrunStats(unsigned long *pXruns, unsigned long *pFailures)
+{
+    *pXruns = atomic_load_explicit(&s_xruns, memory_order_relaxed);
+    *pFailures = atomic_load_explicit(&s_xrunFailures, memory_order_relaxed);
+}
+
+static const AudioOutputBackend s_backend = {
+    .name = "alsa",
+    .open = alsaOpen,
+    .write = alsaWrite,
+    .close = alsaClose,
+    .getDelay = alsaGetDelay,
+    .getXrunStats = alsaGetXrunStats,
+};
+
+// --- Public API ---
+
+const AudioOutputBackend* AudioOutputAlsa_getBackend(void)
+{
+    return &s_backend;
+}
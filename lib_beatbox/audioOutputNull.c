@@ -0,0 +1,54 @@
+/*
+ * Null Audio Output Backend
+ * * Throws the mixed audio away. In real-time mode it sleeps like a sound card
+ * would, so the whole app behaves normally on hosts with no audio hardware.
+ * In fast mode it returns immediately, which turns the playback thread into a
+ * free-running mixer benchmark.
+ */
+
+#include "audioOutput.h"
+
+// --- Internal State ---
+
+static AudioOutputPacer s_pacer;
+
+// --- Backend Implementation ---
+
+static int nullOpen(const AudioOutputConfig *pConfig, unsigned long *pPeriodFrames)
+{
+    AudioOutput_pacerStart(&s_pacer, pConfig->sampleRate, pConfig->realTime);
+    *pPeriodFrames = pConfig->periodFrames ? pConfig->periodFrames : AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES;
+    return 0;
+}
+
+static long nullWrite(const short *pFrames, unsigned long numFrames)
+{
+    (void)pFrames;
+    AudioOutput_pacerWait(&s_pacer, numFrames);
+    return (long)numFrames;
+}
+
+static void nullClose(void)
+{
+    // Nothing to release
+}
+
+static long nullGetDelay(void)
+{
+    return AudioOutput_pacerDelay(&s_pacer);
+}
+
+static const AudioOutputBackend s_backend = {
+    .name = "null",
+    .open = nullOpen,
+    .write = nullWrite,
+    .close = nullClose,
+    .getDelay = nullGetDelay,
+};
+
+// --- Public API ---
+
+const AudioOutputBackend* AudioOutputNull_getBackend(void)
+{
+    return &s_backend;
+}
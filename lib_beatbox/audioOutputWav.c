@@ -0,0 +1,139 @@
+/*
+ * WAV File Audio Output Backend
+ * * Records the mixer's output to a 16-bit PCM .wav file. The RIFF header is
+ * written up front with placeholder sizes and patched on close, so a capture
+ * can run for as long as the app does.
+ * * Writes are paced like a sound card by default so a capture matches what a
+ * listener would hear; with real-time pacing off the file is rendered as fast
+ * as possible (useful for regression tests of the mixing pipeline).
+ */
+
+#include "audioOutput.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+
+// --- Configuration Constants ---
+
+#define WAV_HEADER_SIZE     44
+#define WAV_BITS_PER_SAMPLE 16
+
+// --- Internal State ---
+
+static FILE *s_file = NULL;
+static unsigned int s_channels = 0;
+static unsigned long long s_framesWritten = 0;
+static AudioOutputPacer s_pacer;
+
+// --- Private Helpers ---
+
+static void putLE16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void putLE32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+    p[2] = (uint8_t)((v >> 16) & 0xFF);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Canonical 44-byte PCM header: "RIFF" + "fmt " chunk + "data" chunk header
+static void buildHeader(uint8_t *h, unsigned int sampleRate, unsigned int channels, uint32_t dataBytes)
+{
+    uint16_t blockAlign = (uint16_t)(channels * WAV_BITS_PER_SAMPLE / 8);
+
+    h[0] = 'R'; h[1] = 'I'; h[2] = 'F'; h[3] = 'F';
+    putLE32(h + 4, 36 + dataBytes);
+    h[8] = 'W'; h[9] = 'A'; h[10] = 'V'; h[11] = 'E';
+
+    h[12] = 'f'; h[13] = 'm'; h[14] = 't'; h[15] = ' ';
+    putLE32(h + 16, 16);                       // fmt chunk size
+    putLE16(h + 20, 1);                        // PCM
+    putLE16(h + 22, (uint16_t)channels);
+    putLE32(h + 24, sampleRate);
+    putLE32(h + 28, sampleRate * blockAlign);  // Byte rate
+    putLE16(h + 32, blockAlign);
+    putLE16(h + 34, WAV_BITS_PER_SAMPLE);
+
+    h[36] = 'd'; h[37] = 'a'; h[38] = 't'; h[39] = 'a';
+    putLE32(h + 40, dataBytes);
+}
+
+// --- Backend Implementation ---
+
+static int wavOpen(const AudioOutputConfig *pConfig, unsigned long *pPeriodFrames)
+{
+    if (!pConfig->wavPath) {
+        printf("AudioOutput: No file name given for WAV output.\n");
+        return -EINVAL;
+    }
+
+    s_file = fopen(pConfig->wavPath, "wb");
+    if (!s_file) {
+        int err = errno;
+        printf("AudioOutput: Unable to create %s.\n", pConfig->wavPath);
+        return -err;
+    }
+
+    // Placeholder header; sizes are patched in wavClose()
+    uint8_t header[WAV_HEADER_SIZE];
+    buildHeader(header, pConfig->sampleRate, pConfig->channels, 0);
+    fwrite(header, 1, sizeof(header), s_file);
+
+    s_channels = pConfig->channels;
+    s_framesWritten = 0;
+    AudioOutput_pacerStart(&s_pacer, pConfig->sampleRate, pConfig->realTime);
+    *pPeriodFrames = pConfig->periodFrames ? pConfig->periodFrames : AUDIOOUTPUT_DEFAULT_PERIOD_FRAMES;
+    return 0;
+}
+
+static long wavWrite(const short *pFrames, unsigned long numFrames)
+{
+    // NOTE: Samples are written in host byte order; all our targets are little-endian.
+    size_t written = fwrite(pFrames, sizeof(short) * s_channels, numFrames, s_file);
+    if (written != numFrames) {
+        return -EIO;
+    }
+    s_framesWritten += written;
+    AudioOutput_pacerWait(&s_pacer, numFrames);
+    return (long)written;
+}
+
+static void wavClose(void)
+{
+    if (!s_file) return;
+
+    // Patch the RIFF and data chunk sizes now that the length is known
+    uint8_t header[WAV_HEADER_SIZE];
+    uint32_t dataBytes = (uint32_t)(s_framesWritten * s_channels * sizeof(short));
+    buildHeader(header, s_pacer.sampleRate, s_channels, dataBytes);
+    fseek(s_file, 0, SEEK_SET);
+    fwrite(header, 1, sizeof(header), s_file);
+
+    fclose(s_file);
+    s_file = NULL;
+}
+
+static long wavGetDelay(void)
+{
+    return AudioOutput_pacerDelay(&s_pacer);
+}
+
+static const AudioOutputBackend s_backend = {
+    .name = "wav",
+    .open = wavOpen,
+    .write = wavWrite,
+    .close = wavClose,
+    .getDelay = wavGetDelay,
+};
+
+// --- Public API ---
+
+const AudioOutputBackend* AudioOutputWav_getBackend(void)
+{
+    return &s_backend;
+}
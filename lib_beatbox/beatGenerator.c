@@ -2,17 +2,35 @@
  * Beat Generator Module
  * * This module runs a background thread that acts as the "drummer".
  * It handles the timing (BPM) and sequencing of the drum patterns.
- * It sleeps for the duration of a half-beat, wakes up, plays the 
- * sounds for the current step, and repeats.
+ * * Timing is a look-ahead scheduler locked to the mixer's frame clock:
+ * - Every step (8th note) has an absolute start frame computed from an epoch,
+ *   so rounding and wake-up jitter never accumulate into tempo drift.
+ * - The thread wakes a little before each step and queues its sounds a
+ *   configurable window ahead, and the mixer starts them sample-accurately.
+ * - A tempo change re-anchors the epoch at the next step, so the groove
+ *   continues without a phase jump.
+ * * Patterns are data, not code: see beatPattern for the step tables. Each
+ * mode number is simply an index into the pattern table.
+ * * Once the loop cache has pre-mixed the current pattern (see loopCache), each
+ * pass of it is queued as one voice on the pattern's first step. A tempo or mode
+ * change cuts the queued pass at the next step and continues live until the new
+ * loop is ready; a kit change lets it finish.
  */
 
 #include "beatGenerator.h"
 #include "audioMixer.h"
+#include "beatPattern.h"
+#include "sampleBank.h"
+#include "loopCache.h"
+#include "voiceAllocator.h"
+#include "rtProfile.h"
+#include "probe.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
-#include <unistd.h>
 #include <time.h>
 
 // --- Configuration Constants ---
@@ -21,6 +39,12 @@
 #define BPM_MIN 40      // Slowest allowed tempo
 #define BPM_MAX 300     // Fastest allowed tempo
 
+#define LOOKAHEAD_DEFAULT_MS 40  // How far ahead of the mixer clock steps are queued
+#define LOOKAHEAD_MIN_MS 5
+#define LOOKAHEAD_MAX_MS 500
+#define MAX_SLEEP_MS 10          // Upper bound on a wake-up so tempo/mode changes apply promptly
+#define NS_PER_SECOND 1000000000LL
+
 // --- Internal State ---
 
 static pthread_t s_beatThreadId;
@@ -30,25 +54,54 @@ static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
 // Beat parameters (protected by mutex)
 static int s_tempo = BPM_DEFAULT; 
 static BeatMode s_mode = BEAT_ROCK; 
-static int s_beatCount = 0; // Tracks the current step in the measure (0-7 for 8th notes)
+static bool s_restartPattern = false; // Set by setMode: start the new pattern from step 0
+static int s_lookaheadMs = LOOKAHEAD_DEFAULT_MS;
+
+// Scheduler state (owned by the generator thread)
+// Step n starts on frame: s_epochFrame + (n - s_epochStep) * framesPerStep(tempo, grid)
+static unsigned long long s_epochFrame = 0;
+static long long s_epochStep = 0;
+static int s_epochTempo = BPM_DEFAULT;
+static int s_epochStepsPerBeat = 2;
+static long long s_nextStep = 0;    // Next step that has not been queued yet
+static long long s_patternBase = 0; // Step at which the current pattern started
+
+// Sound ID for each pattern instrument slot, resolved against the current kit
+// (again whenever the sample bank's generation changes, i.e. after a kit swap)
+static int s_slotSoundIds[BEATPATTERN_MAX_INSTRUMENTS];
+static unsigned int s_slotGeneration = 0;
+static bool s_slotsResolved = false;
 
-static wavedata_t* s_pBaseSound = NULL;
-static wavedata_t* s_pSnareSound = NULL;
-static wavedata_t* s_pHiHatSound = NULL;
+// Pre-mixed loops (owned by the generator thread)
+static patternLoop_t *s_pLoop = NULL;    // Loop for the current pattern/tempo/kit, once rendered
+static patternLoop_t *s_pBarLoop = NULL; // Loop whose pass is queued up to s_nextStep (NULL = live)
+static long long s_loopBarStep = 0;      // Step that pass started on
+static unsigned long long s_loopBarFrame = 0; // ...and its frame (kept across a re-anchor)
 
 // --- Private helper prototypes ---
 static void* playbackThread(void* _arg);
-static long long getNsPerHalfBeat(void);
+static unsigned long long getStepFrame(long long step);
+static unsigned long long msToFrames(int ms);
 
 // --- Public API ---
 
-void BeatGenerator_init(wavedata_t* pBaseSound, wavedata_t* pSnareSound, wavedata_t* pHiHatSound)
+void BeatGenerator_init(const char* patternFile)
 {
-    s_pBaseSound = pBaseSound;
-    s_pSnareSound = pSnareSound;
-    s_pHiHatSound = pHiHatSound;
+    // Built-in patterns first (modes 0-2), then any extra grooves from disk.
+    // Track names are sample bank aliases or sound names.
+    BeatPattern_init(SampleBank_findByName);
+    if (patternFile) {
+        int added = BeatPattern_loadFile(patternFile);
+        if (added < 0) {
+            printf("BeatGenerator: No pattern file '%s', using built-in patterns only.\n", patternFile);
+        } else {
+            printf("BeatGenerator: Loaded %d patterns from '%s'.\n", added, patternFile);
+        }
+    }
 
+    s_slotsResolved = false;
     s_stopping = false;
+    LoopCache_init();
     pthread_create(&s_beatThreadId, NULL, playbackThread, NULL);
 }
 
@@ -56,6 +109,19 @@ void BeatGenerator_cleanup(void)
 {
     s_stopping = true;
     pthread_join(s_beatThreadId, NULL);
+
+    // Fade out whatever loop audio is queued, then hand the loops back
+    unsigned long long end = AudioMixer_getFrameClock() + msToFrames(BeatGenerator_getLookahead());
+    AudioMixer_chokeAt(LOOPCACHE_CHOKE_GROUP_BAR, end);
+    AudioMixer_chokeAt(LOOPCACHE_CHOKE_GROUP_TAIL, end);
+    if (s_pBarLoop != s_pLoop) {
+        LoopCache_release(s_pBarLoop);
+    }
+    LoopCache_release(s_pLoop);
+    s_pLoop = NULL;
+    s_pBarLoop = NULL;
+    LoopCache_cleanup();
+
     pthread_mutex_destroy(&s_mutex);
 }
 
@@ -84,12 +150,17 @@ int BeatGenerator_getTempo(void)
 
 void BeatGenerator_setMode(BeatMode newMode)
 {
+    // Ignore modes with no pattern behind them
+    if ((int)newMode < 0 || (int)newMode >= BeatPattern_getCount()) {
+        return;
+    }
+
     pthread_mutex_lock(&s_mutex);
     {
         s_mode = newMode;
-        // Reset count so the new beat starts from the beginning (step 0)
+        // Restart so the new beat starts from the beginning (step 0)
         // This prevents feeling "lost" in the measure when switching styles.
-        s_beatCount = 0; 
+        s_restartPattern = true;
     }
     pthread_mutex_unlock(&s_mutex);
 }
@@ -105,76 +176,250 @@ BeatMode BeatGenerator_getMode(void)
     return mode;
 }
 
+int BeatGenerator_getNumModes(void)
+{
+    return BeatPattern_getCount();
+}
+
+const char* BeatGenerator_getModeName(BeatMode mode)
+{
+    const beatPattern_t *pPattern = BeatPattern_get((int)mode);
+    return pPattern ? pPattern->name : "?";
+}
+
+void BeatGenerator_setLookahead(int lookaheadMs)
+{
+    if (lookaheadMs < LOOKAHEAD_MIN_MS) lookaheadMs = LOOKAHEAD_MIN_MS;
+    if (lookaheadMs > LOOKAHEAD_MAX_MS) lookaheadMs = LOOKAHEAD_MAX_MS;
+    pthread_mutex_lock(&s_mutex);
+    {
+        s_lookaheadMs = lookaheadMs;
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+int BeatGenerator_getLookahead(void)
+{
+    int lookahead = 0;
+    pthread_mutex_lock(&s_mutex);
+    {
+        lookahead = s_lookaheadMs;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return lookahead;
+}
+
 // --- Private Implementation ---
 
-// Calculate the sleep duration for a half-beat (8th note) in nanoseconds.
-// Formula: Time (sec) = (60 sec / BPM) / 2
-static long long getNsPerHalfBeat(void)
+// Absolute mixer frame on which a step starts.
+// Formula: frames per step = SAMPLE_RATE * (60 sec / BPM) / stepsPerBeat
+// (stepsPerBeat = 2 gives 8th notes). Computed from the epoch every time
+// (never accumulated), so there is no drift.
+static unsigned long long getStepFrame(long long step)
+{
+    unsigned long long stepsSinceEpoch = (unsigned long long)(step - s_epochStep);
+    return s_epochFrame
+        + stepsSinceEpoch * AUDIOMIXER_SAMPLE_RATE * 60ULL
+          / ((unsigned long long)s_epochTempo * (unsigned long long)s_epochStepsPerBeat);
+}
+
+static unsigned long long msToFrames(int ms)
+{
+    return (unsigned long long)ms * AUDIOMIXER_SAMPLE_RATE / 1000ULL;
+}
+
+// Map every pattern instrument slot to a sound ID in the current kit.
+static void resolveInstruments(void)
+{
+    unsigned int generation = SampleBank_getGeneration();
+    if (s_slotsResolved && generation == s_slotGeneration) {
+        return;
+    }
+    for (int slot = 0; slot < BeatPattern_getNumInstruments(); slot++) {
+        s_slotSoundIds[slot] = SampleBank_findByName(BeatPattern_getInstrumentName(slot));
+    }
+    s_slotGeneration = generation;
+    s_slotsResolved = true;
+}
+
+// Queue the sounds for one step of a pattern, starting on 'frame'.
+static void playStep(const beatPattern_t *pPattern, int step, unsigned long long frame)
 {
-    int tempo = BeatGenerator_getTempo();
-    double secondsPerBeat = 60.0 / (double)tempo;
-    double secondsPerHalfBeat = secondsPerBeat / 2.0;
-    return (long long)(secondsPerHalfBeat * 1000000000.0);
+    // One table lookup gives every instrument that hits on this step
+    uint32_t hits = pPattern->stepInstruments[step];
+    while (hits) {
+        int slot = __builtin_ctz(hits);
+        hits &= hits - 1;
+        SampleBank_playAt(s_slotSoundIds[slot], frame); // -1 (not in this kit) is ignored
+    }
+}
+
+// The queued pass has ended (on 'frame'): let its tail ring on, and hand its loop
+// back if it has been replaced.
+static void endBar(unsigned long long frame)
+{
+    LoopCache_playTail(s_pBarLoop, s_loopBarFrame, frame);
+    if (s_pBarLoop != s_pLoop) {
+        LoopCache_release(s_pBarLoop);
+    }
+    s_pBarLoop = NULL;
+}
+
+// Cut the queued pass at its first step that is not inside the look-ahead window
+// yet, so tempo and mode changes apply as promptly as with live steps. The pass
+// fades out just before that step, which is then played live.
+static void cutBar(unsigned long long horizon)
+{
+    long long barEnd = s_loopBarStep + s_pBarLoop->numSteps;
+    long long step = s_loopBarStep + 1;
+    while (step < barEnd && getStepFrame(step) < horizon) {
+        step++;
+    }
+    if (step == barEnd) {
+        return; // Already due in full
+    }
+    AudioMixer_chokeAt(LOOPCACHE_CHOKE_GROUP_BAR, getStepFrame(step) - VOICEALLOC_RELEASE_FRAMES);
+    s_nextStep = step;
+    if (s_pBarLoop != s_pLoop) {
+        LoopCache_release(s_pBarLoop);
+    }
+    s_pBarLoop = NULL;
+}
+
+// Keep s_pLoop in step with the pattern, tempo and kit: hand back a stale loop
+// (unless its pass is still queued) and ask for the current one.
+static void updateLoop(BeatMode mode, int tempo)
+{
+    if (s_pLoop && !LoopCache_matches(s_pLoop, (int)mode, tempo, s_slotGeneration)) {
+        if (s_pLoop != s_pBarLoop) {
+            LoopCache_release(s_pLoop);
+        }
+        s_pLoop = NULL;
+    }
+    if (!s_pLoop) {
+        s_pLoop = LoopCache_get((int)mode, tempo, s_slotGeneration);
+    }
+}
+
+// Sleep until 'deadlineNs' (CLOCK_MONOTONIC), or at most MAX_SLEEP_MS.
+static void sleepUntil(long long deadlineNs)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long nowNs = now.tv_sec * NS_PER_SECOND + now.tv_nsec;
+    long long maxNs = nowNs + MAX_SLEEP_MS * 1000000LL;
+    if (deadlineNs > maxNs) deadlineNs = maxNs;
+    if (deadlineNs <= nowNs) return;
+
+    // Absolute sleep, with tv_nsec normalized (valid at any tempo)
+    struct timespec req;
+    req.tv_sec = (time_t)(deadlineNs / NS_PER_SECOND);
+    req.tv_nsec = (long)(deadlineNs % NS_PER_SECOND);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &req, NULL);
 }
 
 static void* playbackThread(void* _arg)
 {
     (void)_arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_SEQUENCER, "sequencer");
+
+    // Anchor step 0 one look-ahead window into the future
+    s_epochTempo = BeatGenerator_getTempo();
+    s_epochStepsPerBeat = BeatPattern_get(BeatGenerator_getMode())->stepsPerBeat;
+    s_epochFrame = AudioMixer_getFrameClock() + msToFrames(BeatGenerator_getLookahead());
+    s_epochStep = 0;
+    s_nextStep = 0;
+    s_patternBase = 0;
 
     while (!s_stopping)
     {
-        BeatMode currentMode = BeatGenerator_getMode();
-        
-        // We use an 8-step sequencer (1 measure of 8th notes)
-        // 0 = Beat 1
-        // 1 = Beat 1.5 (&)
-        // 2 = Beat 2
-        // ...
-        int beat = s_beatCount % 8; 
-
-        if (currentMode == BEAT_ROCK) {
-            // --- Standard Rock Beat ---
-            // On 1 and 3: Base Drum + Hi-Hat
-            if (beat == 0 || beat == 4) { 
-                AudioMixer_queueSound(s_pHiHatSound);
-                AudioMixer_queueSound(s_pBaseSound);
-            } 
-            // On 2 and 4: Snare + Hi-Hat
-            else if (beat == 2 || beat == 6) { 
-                AudioMixer_queueSound(s_pHiHatSound);
-                AudioMixer_queueSound(s_pSnareSound);
-            } 
-            // On all "and" beats (1.5, 2.5...): Hi-Hat only
-            else if (beat % 2 != 0) { 
-                AudioMixer_queueSound(s_pHiHatSound);
-            }
-        
-        } else if (currentMode == BEAT_CUSTOM) {
-            // --- Custom Half-Time Feel ---
-            // Hi-hat keeps time on every 8th note
-            AudioMixer_queueSound(s_pHiHatSound);
-            
-            // Base on 1 only
-            if (beat == 0) { 
-                AudioMixer_queueSound(s_pBaseSound);
+        int tempo, lookaheadMs;
+        BeatMode currentMode;
+        bool restart;
+        pthread_mutex_lock(&s_mutex);
+        {
+            tempo = s_tempo;
+            lookaheadMs = s_lookaheadMs;
+            currentMode = s_mode;
+            restart = s_restartPattern;
+            s_restartPattern = false;
+        }
+        pthread_mutex_unlock(&s_mutex);
+
+        const beatPattern_t *pPattern = BeatPattern_get((int)currentMode);
+        resolveInstruments();
+
+        unsigned long long now = AudioMixer_getFrameClock();
+        unsigned long long horizon = now + msToFrames(lookaheadMs);
+
+        bool retime = (tempo != s_epochTempo || pPattern->stepsPerBeat != s_epochStepsPerBeat);
+        if (s_pBarLoop && (retime || restart)) {
+            cutBar(horizon);
+        }
+
+        // Tempo (or step grid) change: re-anchor at the next unqueued step. That step
+        // keeps the start frame the old tempo gave it; only later steps move. No phase jump.
+        if (retime) {
+            s_epochFrame = getStepFrame(s_nextStep);
+            s_epochStep = s_nextStep;
+            s_epochTempo = tempo;
+            s_epochStepsPerBeat = pPattern->stepsPerBeat;
+        }
+        if (restart) {
+            s_patternBase = s_nextStep;
+        }
+
+        // If we fell more than a step behind (e.g. the thread was stalled), skip the
+        // missed steps instead of firing them all at once.
+        while (getStepFrame(s_nextStep + 1) < now) {
+            s_nextStep++;
+        }
+
+        // Queue every step that falls inside the look-ahead window
+        while (getStepFrame(s_nextStep) < horizon) {
+            // Position within the pattern, e.g. for an 8-step pattern of 8th notes:
+            // 0 = Beat 1
+            // 1 = Beat 1.5 (&)
+            // 2 = Beat 2
+            // ...
+            int step = (int)((s_nextStep - s_patternBase) % pPattern->numSteps);
+            unsigned long long frame = getStepFrame(s_nextStep);
+
+            // How far into the look-ahead window the step already was (0 = queued on time)
+            PROBE_RECORD("beat-late", (double)(horizon - frame) * 1000.0 / AUDIOMIXER_SAMPLE_RATE);
+            Trace_event(TRACE_BEAT_STEP, step, (frame > now) ? (int)(frame - now) : 0);
+
+            // A whole pass in one voice when the loop is ready. After a live pass
+            // (or another loop) its voices still ring, so play it without tails.
+            if (step == 0 && s_pLoop && LoopCache_matches(s_pLoop, (int)currentMode, tempo, s_slotGeneration)) {
+                bool continues = (s_pBarLoop == s_pLoop);
+                if (s_pBarLoop && !continues) {
+                    endBar(frame);
+                }
+                // Queued up to where the step clock puts the next pass, to the frame
+                LoopCache_playBar(s_pLoop, continues, frame, getStepFrame(s_nextStep + pPattern->numSteps));
+                s_pBarLoop = s_pLoop;
+                s_loopBarStep = s_nextStep;
+                s_loopBarFrame = frame;
+                s_nextStep += pPattern->numSteps;
+                continue;
             }
-            // Snare on 3 only (Beat 3 is index 4 in 0-7 counting)
-            if (beat == 4) { 
-                AudioMixer_queueSound(s_pSnareSound);
+            if (s_pBarLoop) {
+                endBar(frame);
             }
+            playStep(pPattern, step, frame);
+            s_nextStep++;
         }
-        // If BEAT_NONE, we just sleep without queuing sounds.
 
-        // Advance to the next step in the measure
-        pthread_mutex_lock(&s_mutex);
-        s_beatCount++;
-        pthread_mutex_unlock(&s_mutex);
+        updateLoop(currentMode, tempo);
 
-        // Wait for the duration of one 8th note
-        struct timespec req = {0};
-        req.tv_nsec = getNsPerHalfBeat();
-        nanosleep(&req, NULL);
+        // Sleep until the next step enters the window (it is at or beyond the horizon here)
+        unsigned long long framesUntilDue = getStepFrame(s_nextStep) - horizon;
+        long long waitNs = (long long)(framesUntilDue * NS_PER_SECOND / AUDIOMIXER_SAMPLE_RATE);
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        sleepUntil(ts.tv_sec * NS_PER_SECOND + ts.tv_nsec + waitNs);
     }
 
     return NULL;
-}
\ No newline at end of file
+}
@@ -4,15 +4,19 @@
 #include "audioMixer.h"
 
 // Drum Beat Modes
-// Matches the integer values expected by the JavaScript UI.
+// A mode is an index into the pattern table (see beatPattern.h). The built-in
+// modes below always exist and match the integer values expected by the JavaScript UI;
+// patterns loaded from file follow at 3, 4, ...
 typedef enum {
     BEAT_NONE = 0,   // Silence
     BEAT_ROCK = 1,   // Standard Rock Beat
     BEAT_CUSTOM = 2  // Alternative pattern
 } BeatMode;
 
-// Initialize the generator thread with the audio assets.
-void BeatGenerator_init(wavedata_t* pBaseSound, wavedata_t* pSnareSound, wavedata_t* pHiHatSound);
+// Initialize the generator thread. The sample bank must already be loaded, with the
+// "base", "snare" and "hihat" aliases set (the built-in patterns use them).
+// Extra patterns are loaded from 'patternFile' (may be NULL, or missing on disk).
+void BeatGenerator_init(const char* patternFile);
 void BeatGenerator_cleanup(void);
 
 // Control Tempo (BPM)
@@ -21,7 +25,18 @@ void BeatGenerator_setTempo(int newTempo);
 int BeatGenerator_getTempo(void);
 
 // Control Beat Pattern
+// Out-of-range modes are ignored.
 void BeatGenerator_setMode(BeatMode newMode);
 BeatMode BeatGenerator_getMode(void);
 
+// Number of selectable modes (built-in + loaded patterns) and their names.
+int BeatGenerator_getNumModes(void);
+const char* BeatGenerator_getModeName(BeatMode mode);
+
+// Control the scheduling look-ahead window (milliseconds, clamped 5 - 500).
+// Steps are queued this far ahead of the mixer clock; it must exceed one audio
+// period plus thread wake-up latency for every hit to land sample-accurately.
+void BeatGenerator_setLookahead(int lookaheadMs);
+int BeatGenerator_getLookahead(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,309 @@
+/*
+ * Beat Pattern Module
+ * * Holds the table of drum patterns the Beat Generator can play.
+ * * Each pattern is stored as one 64-bit row per instrument track (bit n set = hit
+ * on step n), and transposed at load time into a per-step instrument mask so the
+ * sequencer evaluates a step with a single table lookup.
+ * * A few patterns are built in (so the mode numbers the web UI expects always
+ * exist); any number of extra grooves can be loaded from a text file at startup.
+ * The table is only written during initialization, before the generator thread
+ * starts, and is read-only afterwards.
+ */
+
+#include "beatPattern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+// --- Configuration Constants ---
+
+#define LINE_BUFFER_SIZE 256
+#define DEFAULT_STEPS_PER_BEAT 2 // 8th notes
+#define MAX_STEPS_PER_BEAT 8
+
+// --- Internal State ---
+
+static beatPattern_t s_patterns[BEATPATTERN_MAX_PATTERNS];
+static int s_numPatterns = 0;
+
+static BeatPatternLookup s_lookup = NULL;
+
+// Instrument names referenced by the committed patterns (index = bit in a step mask)
+static char s_instrumentNames[BEATPATTERN_MAX_INSTRUMENTS][BEATPATTERN_NAME_LEN];
+static int s_numInstruments = 0;
+
+// Instrument name of each track of the pattern being built. Slots are only
+// assigned when it is committed, so a rejected pattern takes none.
+static char s_trackNames[BEATPATTERN_MAX_TRACKS][BEATPATTERN_NAME_LEN];
+
+// --- Private Helpers ---
+
+// Slot of an instrument name, or -1 if no committed pattern uses it.
+static int findInstrumentSlot(const char *name)
+{
+    for (int i = 0; i < s_numInstruments; i++) {
+        if (strcmp(s_instrumentNames[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Build the per-step lookup table from the track rows.
+static void transposePattern(beatPattern_t *pPattern)
+{
+    memset(pPattern->stepInstruments, 0, sizeof(pPattern->stepInstruments));
+    for (int t = 0; t < pPattern->numTracks; t++) {
+        uint32_t instrumentBit = 1u << pPattern->trackInstrument[t];
+        for (int step = 0; step < pPattern->numSteps; step++) {
+            if (pPattern->trackSteps[t] & (1ULL << step)) {
+                pPattern->stepInstruments[step] |= instrumentBit;
+            }
+        }
+    }
+}
+
+// Start a new, empty pattern at the end of the table. Returns NULL if the table is full.
+static beatPattern_t* appendPattern(const char *name, int numSteps, int stepsPerBeat)
+{
+    if (s_numPatterns >= BEATPATTERN_MAX_PATTERNS) {
+        return NULL;
+    }
+    beatPattern_t *pPattern = &s_patterns[s_numPatterns];
+    memset(pPattern, 0, sizeof(*pPattern));
+    snprintf(pPattern->name, sizeof(pPattern->name), "%s", name);
+    pPattern->numSteps = numSteps;
+    pPattern->stepsPerBeat = stepsPerBeat;
+    return pPattern;
+}
+
+// Give the tracks of the pattern at the end of the table their instrument slots and
+// make it visible to the sequencer. Returns false (after printing why, and taking
+// no slots) if its instruments do not fit in the instrument table.
+static bool commitPattern(beatPattern_t *pPattern, const char *fileName)
+{
+    // Count the names new to the table (once each) before taking any slot
+    int numNew = 0;
+    for (int t = 0; t < pPattern->numTracks; t++) {
+        bool isNew = (findInstrumentSlot(s_trackNames[t]) < 0);
+        for (int earlier = 0; earlier < t && isNew; earlier++) {
+            isNew = (strcmp(s_trackNames[earlier], s_trackNames[t]) != 0);
+        }
+        numNew += isNew ? 1 : 0;
+    }
+    if (s_numInstruments + numNew > BEATPATTERN_MAX_INSTRUMENTS) {
+        fprintf(stderr, "Patterns: %s: more than %d different instruments; '%s' ignored.\n",
+                fileName, BEATPATTERN_MAX_INSTRUMENTS, pPattern->name);
+        return false;
+    }
+
+    for (int t = 0; t < pPattern->numTracks; t++) {
+        int slot = findInstrumentSlot(s_trackNames[t]);
+        if (slot < 0) {
+            slot = s_numInstruments++;
+            snprintf(s_instrumentNames[slot], BEATPATTERN_NAME_LEN, "%s", s_trackNames[t]);
+        }
+        pPattern->trackInstrument[t] = slot;
+    }
+    transposePattern(pPattern);
+    s_numPatterns++;
+    return true;
+}
+
+// Commit a built-in pattern. Their rows are fixed and the instrument table starts
+// empty, so this only fails if one is mistyped; it then plays silence rather than
+// shifting the mode numbers of the patterns after it.
+static void commitBuiltIn(beatPattern_t *pPattern, bool tracksValid)
+{
+    if (!tracksValid || !commitPattern(pPattern, "built-in")) {
+        fprintf(stderr, "Patterns: built-in pattern '%s' is invalid; it plays nothing.\n", pPattern->name);
+        pPattern->numTracks = 0;
+        commitPattern(pPattern, "built-in");
+    }
+}
+
+// Parse a row such as "x...|x..." into a step bitmask.
+// Returns the number of steps read, or -1 on an invalid character.
+static int parseRow(const char *row, uint64_t *pSteps)
+{
+    int step = 0;
+    *pSteps = 0;
+    for (const char *c = row; *c != '\0'; c++) {
+        if (*c == ' ' || *c == '\t' || *c == '|') continue;
+        if (step >= BEATPATTERN_MAX_STEPS) return BEATPATTERN_MAX_STEPS + 1;
+
+        if (*c == 'x' || *c == 'X' || *c == 'o') {
+            *pSteps |= 1ULL << step;
+        } else if (*c != '.' && *c != '-') {
+            return -1;
+        }
+        step++;
+    }
+    return step;
+}
+
+// Add a track to a pattern. The instrument is kept by name until the pattern is
+// committed. Returns false (after printing why) on error.
+static bool addTrack(beatPattern_t *pPattern, const char *instrument, const char *row,
+                     const char *fileName, int lineNum)
+{
+    if (pPattern->numTracks >= BEATPATTERN_MAX_TRACKS) {
+        fprintf(stderr, "Patterns: %s:%d: too many tracks in '%s'.\n", fileName, lineNum, pPattern->name);
+        return false;
+    }
+
+    uint64_t steps;
+    int count = parseRow(row, &steps);
+    if (count != pPattern->numSteps) {
+        fprintf(stderr, "Patterns: %s:%d: track '%s' has %d steps, expected %d.\n",
+                fileName, lineNum, instrument, count, pPattern->numSteps);
+        return false;
+    }
+
+    snprintf(s_trackNames[pPattern->numTracks], BEATPATTERN_NAME_LEN, "%s", instrument);
+    pPattern->trackSteps[pPattern->numTracks] = steps;
+    pPattern->numTracks++;
+    return true;
+}
+
+// --- Public API ---
+
+void BeatPattern_init(BeatPatternLookup lookup)
+{
+    s_lookup = lookup;
+    s_numPatterns = 0;
+    s_numInstruments = 0;
+
+    // Built-in patterns. Their indices match the BeatMode values the web UI sends,
+    // and they use the three role instruments (base, snare, hi-hat). They are not
+    // checked against the kit: the generator maps the names to whichever kit is loaded.
+    beatPattern_t *p;
+    bool valid;
+
+    // 0: None (silence, but the clock keeps running)
+    p = appendPattern("None", 8, DEFAULT_STEPS_PER_BEAT);
+    commitBuiltIn(p, true);
+
+    // 1: Standard Rock Beat
+    // Base on 1 and 3, snare on 2 and 4, hi-hat on every 8th note.
+    p = appendPattern("Rock", 8, DEFAULT_STEPS_PER_BEAT);
+    valid = addTrack(p, "base", "x...x...", "built-in", 0)
+         && addTrack(p, "snare", "..x...x.", "built-in", 0)
+         && addTrack(p, "hihat", "xxxxxxxx", "built-in", 0);
+    commitBuiltIn(p, valid);
+
+    // 2: Custom Half-Time Feel
+    // Hi-hat keeps time on every 8th note, base on 1 only, snare on 3 only.
+    p = appendPattern("Custom", 8, DEFAULT_STEPS_PER_BEAT);
+    valid = addTrack(p, "base", "x.......", "built-in", 0)
+         && addTrack(p, "snare", "....x...", "built-in", 0)
+         && addTrack(p, "hihat", "xxxxxxxx", "built-in", 0);
+    commitBuiltIn(p, valid);
+}
+
+int BeatPattern_loadFile(const char *fileName)
+{
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        return -1;
+    }
+
+    char line[LINE_BUFFER_SIZE];
+    int lineNum = 0;
+    int added = 0;
+    beatPattern_t *pCurrent = NULL; // Pattern being filled (not yet committed)
+    bool currentValid = false;
+    bool inPattern = false;         // Track rows belong to a (possibly rejected) pattern
+
+    while (fgets(line, sizeof(line), file)) {
+        lineNum++;
+
+        // Strip comments and trailing whitespace
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        size_t len = strlen(line);
+        while (len > 0 && isspace((unsigned char)line[len - 1])) line[--len] = '\0';
+
+        char keyword[BEATPATTERN_NAME_LEN];
+        int consumed = 0;
+        if (sscanf(line, "%31s %n", keyword, &consumed) != 1) {
+            continue; // Blank line
+        }
+
+        if (strcmp(keyword, "pattern") == 0) {
+            // Commit the previous pattern before starting a new one
+            if (pCurrent && currentValid && commitPattern(pCurrent, fileName)) {
+                added++;
+            }
+            pCurrent = NULL;
+            currentValid = false;
+            inPattern = true;
+
+            char name[BEATPATTERN_NAME_LEN];
+            int numSteps = 0;
+            int stepsPerBeat = DEFAULT_STEPS_PER_BEAT;
+            int fields = sscanf(line + consumed, "%31s %d %d", name, &numSteps, &stepsPerBeat);
+            if (fields < 2 || numSteps < 1 || numSteps > BEATPATTERN_MAX_STEPS
+                    || stepsPerBeat < 1 || stepsPerBeat > MAX_STEPS_PER_BEAT) {
+                fprintf(stderr, "Patterns: %s:%d: expected 'pattern <name> <1-%d steps> [1-%d steps per beat]'.\n",
+                        fileName, lineNum, BEATPATTERN_MAX_STEPS, MAX_STEPS_PER_BEAT);
+                continue;
+            }
+
+            pCurrent = appendPattern(name, numSteps, stepsPerBeat);
+            currentValid = (pCurrent != NULL);
+            if (!pCurrent) {
+                fprintf(stderr, "Patterns: %s:%d: pattern table full (%d), ignoring the rest.\n",
+                        fileName, lineNum, BEATPATTERN_MAX_PATTERNS);
+                break;
+            }
+        }
+        else if (pCurrent) {
+            // Track row for the current pattern; a bad row (or an instrument the
+            // kit does not have) drops the whole pattern
+            if (!s_lookup || s_lookup(keyword) < 0) {
+                fprintf(stderr, "Patterns: %s:%d: unknown instrument '%s'.\n", fileName, lineNum, keyword);
+                currentValid = false;
+            } else if (!addTrack(pCurrent, keyword, line + consumed, fileName, lineNum)) {
+                currentValid = false;
+            }
+        }
+        else if (!inPattern) {
+            fprintf(stderr, "Patterns: %s:%d: track '%s' outside of a pattern.\n", fileName, lineNum, keyword);
+        }
+    }
+
+    if (pCurrent && currentValid && commitPattern(pCurrent, fileName)) {
+        added++;
+    }
+
+    fclose(file);
+    return added;
+}
+
+int BeatPattern_getCount(void)
+{
+    return s_numPatterns;
+}
+
+const beatPattern_t* BeatPattern_get(int index)
+{
+    if (index < 0 || index >= s_numPatterns) {
+        return NULL;
+    }
+    return &s_patterns[index];
+}
+
+int BeatPattern_getNumInstruments(void)
+{
+    return s_numInstruments;
+}
+
+const char* BeatPattern_getInstrumentName(int slot)
+{
+    if (slot < 0 || slot >= s_numInstruments) {
+        return "?";
+    }
+    return s_instrumentNames[slot];
+}
@@ -0,0 +1,57 @@
+#ifndef BEATPATTERN_H
+#define BEATPATTERN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BEATPATTERN_MAX_PATTERNS    64
+#define BEATPATTERN_MAX_STEPS       64 // One bit per step in a track row
+#define BEATPATTERN_MAX_TRACKS      16
+#define BEATPATTERN_MAX_INSTRUMENTS 32 // Distinct instrument names; one bit each in a step mask
+#define BEATPATTERN_NAME_LEN        32
+
+// A drum pattern stored as a compact step table.
+typedef struct {
+    char name[BEATPATTERN_NAME_LEN];
+    int numSteps;     // 1 - 64
+    int stepsPerBeat; // Grid resolution: 2 = 8th notes, 4 = 16th notes, 3 = triplets...
+
+    // As written: one bitmask row per instrument track (bit n = hit on step n)
+    int numTracks;
+    int trackInstrument[BEATPATTERN_MAX_TRACKS];
+    uint64_t trackSteps[BEATPATTERN_MAX_TRACKS];
+
+    // Transposed at load time: bit i = instrument slot i hits on this step
+    // (see BeatPattern_getInstrumentName).
+    // Playing a step is a single lookup into this table.
+    uint32_t stepInstruments[BEATPATTERN_MAX_STEPS];
+} beatPattern_t;
+
+// Resolves a track's instrument name to a sound ID, or returns -1 if the name is unknown.
+typedef int (*BeatPatternLookup)(const char *name);
+
+// Reset to the built-in patterns (0 = None, 1 = Rock, 2 = Custom).
+// 'lookup' validates instrument names as patterns load from a file; the built-ins
+// use "base", "snare" and "hihat" whatever the kit. Patterns keep the names (as
+// instrument slots), so the player can map them to whichever kit is loaded.
+void BeatPattern_init(BeatPatternLookup lookup);
+
+// Append the patterns in a text file to the table. Format:
+//   # comment
+//   pattern <name> <steps> [steps-per-beat]
+//   <instrument> <row>        row: 'x' = hit, '.' = rest, '|' and spaces ignored
+// Returns the number of patterns added, or -1 if the file could not be opened.
+int BeatPattern_loadFile(const char *fileName);
+
+// Number of patterns available (valid indices are 0 .. count-1).
+int BeatPattern_getCount(void);
+
+// Pattern at 'index', or NULL if out of range.
+const beatPattern_t* BeatPattern_get(int index);
+
+// Instrument slots used by the loaded patterns (valid slots are 0 .. count-1),
+// and the instrument name behind each slot ("?" if out of range).
+int BeatPattern_getNumInstruments(void);
+const char* BeatPattern_getInstrumentName(int slot);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef CONTROLPROTOCOL_H
+#define CONTROLPROTOCOL_H
+
+// Binary control protocol, served by the UDP server on the same port as the text
+// commands. A datagram whose first byte is CONTROL_MAGIC is a binary request (text
+// commands are printable ASCII, so they never start with it).
+//
+// Request:  header (8 bytes), then the opcode's arguments as int32 little-endian
+//   [0] CONTROL_MAGIC  [1] version  [2] opcode  [3] flags  [4..7] request ID (LE)
+// Reply:    header (8 bytes), then the opcode's results as int32 little-endian
+//   [0] CONTROL_MAGIC  [1] version  [2] opcode  [3] status [4..7] request ID (LE)
+//
+// The request ID is echoed untouched, so a client can match replies to requests.
+// A request with extra or missing argument bytes is answered with
+// CONTROL_STATUS_BAD_LENGTH; one with another version with CONTROL_STATUS_BAD_VERSION.
+
+#include <stdint.h>
+
+#define CONTROL_MAGIC       0xBB
+#define CONTROL_VERSION     1
+#define CONTROL_HEADER_SIZE 8
+#define CONTROL_MAX_ARGS    4
+
+// Request flags
+#define CONTROL_FLAG_NO_REPLY 0x01  // Fire and forget: no reply, even on error
+
+// Fixed-point unit of the PLAY gain, pan and pitch arguments (1000 = 1.0)
+#define CONTROL_FIXED_ONE 1000
+
+typedef enum {
+    CONTROL_OP_GET_VOLUME = 0x01,    // -> volume
+    CONTROL_OP_SET_VOLUME,           // volume -> volume
+    CONTROL_OP_GET_TEMPO,            // -> bpm
+    CONTROL_OP_SET_TEMPO,            // bpm -> bpm
+    CONTROL_OP_GET_MODE,             // -> mode
+    CONTROL_OP_SET_MODE,             // mode -> mode
+    CONTROL_OP_PLAY,                 // sound ID, gain, pan, pitch (fixed point) ->
+    CONTROL_OP_GET_POLYPHONY,        // -> voices
+    CONTROL_OP_SET_POLYPHONY,        // voices -> voices
+    CONTROL_OP_STOP,                 // ->
+    CONTROL_NUM_OPCODES
+} ControlOpcode;
+
+typedef enum {
+    CONTROL_STATUS_OK = 0,
+    CONTROL_STATUS_BAD_VERSION,
+    CONTROL_STATUS_UNKNOWN_OPCODE,
+    CONTROL_STATUS_BAD_LENGTH,
+    CONTROL_STATUS_BAD_ARGUMENT,
+} ControlStatus;
+
+#endif
@@ -8,17 +8,23 @@
  * 3. Poll the joystick for volume control.
  * 4. Enforce debounce logic (preventing volume changes immediately after a remote update).
  * 5. Print system statistics to the console once per second.
+ * 6. Drop to a slower poll rate while nothing is playing and nobody is touching
+ *    the board; motion, the joystick, a command or a playing voice restores it.
  */
 
 #include "inputMan.h"
 #include "audioMixer.h"
+#include "voiceAllocator.h"
 #include "accelerometer.h"
 #include "joystick.h"
 #include "rotary.h"     
 #include "mpc3208.h"    
 #include "intervalTimer.h"
 #include "beatGenerator.h"
+#include "rtProfile.h"
+#include "logger.h"
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <pthread.h>
@@ -29,6 +35,8 @@
 
 #define LOCKOUT_DURATION_SEC 2   // How long to ignore joystick after web/UDP volume change
 #define POLL_RATE_MS 10          // Polling period (10ms = 100Hz)
+#define POLL_RATE_IDLE_MS 40     // Polling period while idle (40ms = 25Hz)
+#define IDLE_AFTER_MS 2000       // Quiet time before switching to the idle rate
 #define JOYSTICK_DEBOUNCE_CYCLES 25 // Hold-down delay for joystick volume
 #define VOLUME_INCREMENT 5       // Step size for joystick volume change
 
@@ -41,15 +49,20 @@ static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
 static time_t s_lastManualVolumeSet = 0; // Timestamp of last remote volume change
 static int s_joystickDebounceCounter = 0; 
 
+// Idle polling. The thread sleeps on s_wakeCond so a command can wake it at once.
+static pthread_cond_t s_wakeCond;
+static bool s_activityPending = false;   // Set by InputMan_notifyActivity (under s_mutex)
+static volatile bool s_idle = false;     // Polling at POLL_RATE_IDLE_MS
+
 // --- Private Helpers ---
 static void* inputThread(void* _arg);
 static void printStats(void);
-static void handleJoystick(void);
+static bool handleJoystick(void);
 
 
 // --- Public API ---
 
-void InputMan_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat) {
+void InputMan_init(void) {
     
     // 1. Initialize hardware drivers
     // IMPORTANT: mpc3208 must be init before Accelerometer/Joystick try to read it.
@@ -58,19 +71,31 @@ void InputMan_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat) {
 
     // 2. Initialize the specific input sub-modules
     // Accelerometer will read initial state here, so SPI must be ready.
-    Accelerometer_init(pBase, pSnare, pHiHat);
+    Accelerometer_init();
     Joystick_init();
     Rotary_init(); 
 
     // 3. Initialize state and start thread
+    // The wake-up condition times out on CLOCK_MONOTONIC, like the rest of the timing
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s_wakeCond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+
     s_lastManualVolumeSet = time(NULL); 
     s_stopping = false;
+    s_idle = false;
     pthread_create(&s_inputThreadId, NULL, inputThread, NULL);
 }
 
 void InputMan_cleanup(void) {
+    pthread_mutex_lock(&s_mutex);
     s_stopping = true;
+    pthread_cond_signal(&s_wakeCond);
+    pthread_mutex_unlock(&s_mutex);
     pthread_join(s_inputThreadId, NULL);
+    pthread_cond_destroy(&s_wakeCond);
     
     // Cleanup hardware drivers
     Rotary_cleanup();
@@ -89,11 +114,42 @@ void InputMan_notifyManualVolumeSet(void) {
     pthread_mutex_unlock(&s_mutex);
 }
 
+// Called by the UDP server for every command: leave the idle poll rate now,
+// rather than up to one idle period later.
+void InputMan_notifyActivity(void) {
+    pthread_mutex_lock(&s_mutex);
+    s_activityPending = true;
+    pthread_cond_signal(&s_wakeCond);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+bool InputMan_isIdle(void) {
+    return s_idle;
+}
+
 // --- Internal Logic ---
 
+// Append to the status line being built (truncated at LOG_MESSAGE_LEN)
+static void append(char *line, int *pLen, const char *format, ...) {
+    if (*pLen >= LOG_MESSAGE_LEN - 1) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line + *pLen, LOG_MESSAGE_LEN - *pLen, format, args);
+    va_end(args);
+    if (n > 0) {
+        *pLen += n;
+        if (*pLen > LOG_MESSAGE_LEN - 1) *pLen = LOG_MESSAGE_LEN - 1;
+    }
+}
+
 // Prints the dashboard string required by the assignment:
 // "MO <Mode> <BPM>bpm vol:<Vol> Audio [...] Accel [...]"
 static void printStats(void) {
+    // Built up here and handed to the logger in one piece (never blocks on stdout)
+    char line[LOG_MESSAGE_LEN];
+    int len = 0;
     double minAudio, maxAudio, avgAudio;
     int countAudio;
     double minAccel, maxAccel, avgAccel;
@@ -104,28 +160,84 @@ static void printStats(void) {
     int volume = AudioMixer_getVolume();
     
     // Basic status info
-    printf("MO %d %dbpm vol:%d ", (int)mode, tempo, volume);
+    append(line, &len, "MO %d %dbpm vol:%d ", (int)mode, tempo, volume);
     
     // Audio timing stats (jitter analysis)
     if (Interval_getStats(INTERVAL_AUDIO, &minAudio, &maxAudio, &avgAudio, &countAudio)) {
-        printf("Audio [%.3f, %.3f] avg %.3f/%d ", minAudio, maxAudio, avgAudio, countAudio);
+        append(line, &len, "Audio [%.3f, %.3f] avg %.3f/%d ", minAudio, maxAudio, avgAudio, countAudio);
         Interval_reset(INTERVAL_AUDIO);
     } else {
-        printf("Audio [N/A, N/A] avg N/A/0 ");
+        append(line, &len, "Audio [N/A, N/A] avg N/A/0 ");
     }
     
     // Accelerometer polling stats
     if (Interval_getStats(INTERVAL_ACCEL, &minAccel, &maxAccel, &avgAccel, &countAccel)) {
-        printf("Accel [%.3f, %.3f] avg %.3f/%d", minAccel, maxAccel, avgAccel, countAccel);
+        append(line, &len, "Accel [%.3f, %.3f] avg %.3f/%d", minAccel, maxAccel, avgAccel, countAccel);
         Interval_reset(INTERVAL_ACCEL);
     } else {
-        printf("Accel [N/A, N/A] avg N/A/0");
+        append(line, &len, "Accel [N/A, N/A] avg N/A/0");
+    }
+
+    // Trigger-to-DAC latency (only shown once something has been played)
+    double minLatency, maxLatency, avgLatency;
+    int countLatency;
+    if (Interval_getStats(INTERVAL_LATENCY, &minLatency, &maxLatency, &avgLatency, &countLatency)) {
+        append(line, &len, " Latency [%.3f, %.3f] avg %.3f/%d", minLatency, maxLatency, avgLatency, countLatency);
+        Interval_reset(INTERVAL_LATENCY);
+    }
+
+    // Render time per period as a share of the period (DSP load)
+    double minLoad, maxLoad, avgLoad;
+    int countLoad;
+    if (Interval_getStats(INTERVAL_DSP_LOAD, &minLoad, &maxLoad, &avgLoad, &countLoad)) {
+        append(line, &len, " DSP [%.1f%%, %.1f%%] avg %.1f%%", minLoad, maxLoad, avgLoad);
+        Interval_reset(INTERVAL_DSP_LOAD);
+    }
+
+    // Under-runs and dropped triggers (only shown once something has actually been lost)
+    audioMixerStats_t mixerStats;
+    AudioMixer_getStats(&mixerStats);
+    if (mixerStats.xruns > 0) {
+        append(line, &len, " xrun[%lu fail:%lu]", mixerStats.xruns, mixerStats.xrunFailures);
+    }
+    if (mixerStats.queueDrops > 0 || mixerStats.voiceDrops > 0) {
+        append(line, &len, " drop[q:%lu v:%lu]", mixerStats.queueDrops, mixerStats.voiceDrops);
+    }
+
+    // Voice allocation (only shown once a voice has been stolen or choked)
+    int activeVoices;
+    unsigned long stolenVoices, chokedVoices;
+    VoiceAlloc_getStats(&activeVoices, &stolenVoices, &chokedVoices);
+    if (stolenVoices > 0 || chokedVoices > 0) {
+        append(line, &len, " voices[%d/%d steal:%lu choke:%lu]", activeVoices, VoiceAlloc_getPolyphony(),
+               stolenVoices, chokedVoices);
+    }
+
+    // Named timing probes (see probe.h), once they have recorded something
+    for (int type = NUM_INTERVALS; type < Interval_getCount(); type++) {
+        IntervalSummary probe;
+        if (Interval_getSummary(type, INTERVAL_WINDOW_CURRENT, &probe)) {
+            append(line, &len, " %s[p50 %.3f p99 %.3f max %.3f]", Interval_getName(type), probe.p50, probe.p99, probe.max);
+            Interval_reset(type);
+        }
+    }
+
+    // Log messages lost to a full queue
+    unsigned long logDrops = Log_getDroppedCount();
+    if (logDrops > 0) {
+        append(line, &len, " log-drop:%lu", logDrops);
+    }
+
+    // Inputs polled at the idle rate (nothing playing, board untouched)
+    if (s_idle) {
+        append(line, &len, " idle");
     }
     
-    printf("\n");
+    Log_write(LOG_LEVEL_INFO, "%s", line);
 }
 
-static void handleJoystick(void) {
+// Returns true while the joystick is pushed (whether or not it changed the volume).
+static bool handleJoystick(void) {
     // Read the GPIO direction (abstracted by Joystick module)
     int direction = Joystick_readVolumeDirection();
     int current_volume;
@@ -160,6 +272,34 @@ static void handleJoystick(void) {
             s_joystickDebounceCounter = JOYSTICK_DEBOUNCE_CYCLES; 
         }
     }
+    return direction != 0;
+}
+
+static long long nowMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+// Sleep for 'ms', or until InputMan_notifyActivity/InputMan_cleanup.
+// Returns true if woken by activity.
+static bool sleepFor(int ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += (long)ms * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&s_mutex);
+    while (!s_activityPending && !s_stopping) {
+        if (pthread_cond_timedwait(&s_wakeCond, &s_mutex, &deadline) != 0) {
+            break; // Timed out
+        }
+    }
+    bool woken = s_activityPending;
+    s_activityPending = false;
+    pthread_mutex_unlock(&s_mutex);
+    return woken;
 }
 
 
@@ -167,14 +307,25 @@ static void handleJoystick(void) {
 
 static void* inputThread(void* _arg) {
     (void)_arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_INPUT, "input");
 
     time_t lastPrintTime = time(NULL);
+    long long lastActiveMs = nowMs();
+    bool woken = false;
 
     while (!s_stopping) {
         
         // 1. Poll Hardware
-        Accelerometer_poll(); 
-        handleJoystick();
+        bool moved = Accelerometer_poll(); 
+        bool pushed = handleJoystick();
+
+        // Go idle only once the mixer has had nothing to play for a while and
+        // nobody has touched the board; any sign of life switches back at once.
+        long long currentMs = nowMs();
+        if (moved || pushed || woken || !AudioMixer_isIdle()) {
+            lastActiveMs = currentMs;
+        }
+        s_idle = (currentMs - lastActiveMs) >= IDLE_AFTER_MS;
 
         // 2. Output Statistics (Once per second)
         if (time(NULL) != lastPrintTime) {
@@ -182,8 +333,8 @@ static void* inputThread(void* _arg) {
             lastPrintTime = time(NULL);
         }
 
-        // 3. Sleep for sample period (10ms)
-        usleep(POLL_RATE_MS * 1000); 
+        // 3. Sleep for sample period (10ms, or 40ms while idle)
+        woken = sleepFor(s_idle ? POLL_RATE_IDLE_MS : POLL_RATE_MS);
     }
     return NULL;
 }
\ No newline at end of file
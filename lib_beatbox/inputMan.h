@@ -1,12 +1,12 @@
 #ifndef INPUTMAN_H
 #define INPUTMAN_H
 
-#include "audioMixer.h"
 #include <time.h>
+#include <stdbool.h>
 
 // Initialize the Input Manager.
 // This starts a background thread that polls the Joystick and Accelerometer.
-void InputMan_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat);
+void InputMan_init(void);
 
 // Stop the input thread and cleanup resources.
 void InputMan_cleanup(void);
@@ -15,4 +15,11 @@ void InputMan_cleanup(void);
 // It triggers a temporary lockout of joystick volume control to prevent conflicts.
 void InputMan_notifyManualVolumeSet(void);
 
+// Call this for every remote command. While idle (nothing playing, board untouched)
+// the inputs are polled at a lower rate; this brings the full rate back immediately.
+void InputMan_notifyActivity(void);
+
+// True while the inputs are polled at the idle rate.
+bool InputMan_isIdle(void);
+
 #endif
\ No newline at end of file
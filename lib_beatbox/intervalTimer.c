@@ -2,32 +2,82 @@
  * Interval Timer & Stats Module
  * * This module tracks the timing jitter of critical events (Audio refill, Accel poll).
  * It records the time difference between successive calls to `Interval_mark()`
- * and calculates min, max, and average durations.
+ * (or a value handed to `Interval_record()`) into a histogram, and reports the
+ * min, max, average and percentiles over the current window and the lifetime.
  * * Used to prove that the system is meeting its real-time deadlines.
+ * * Recording is lock-free: every thread gets its own histogram ("lane") per
+ * interval type, updated with relaxed atomics, so the audio thread never waits
+ * for the input thread to record a sample. Readers merge the lanes.
+ * * Histograms are log-bucketed (HDR-style): values (in ns) below 64 have a bucket
+ * each, above that every power of two is split into 64 buckets, so any value is
+ * known to within ~1.6%.
  */
 
 #include "intervalTimer.h"
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <pthread.h>
 #include <limits.h>
+#include <string.h>
+
+// --- Configuration Constants ---
+
+#define SUB_BUCKET_BITS 6
+#define SUB_BUCKETS     (1 << SUB_BUCKET_BITS)
+#define MAX_VALUE_BITS  40   // Values are clamped below 2^40 ns (~18 minutes)
+#define NUM_BUCKETS     ((MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS)
+
+#define MAX_LANES 8          // Recording threads per interval type (extra threads share the last lane)
+#define MAX_NAME_LEN 24
+
+#define NS_PER_MS 1000000.0
 
 // --- Internal Data Structures ---
 
+// One thread's histogram of one interval type. The recording thread is the only
+// writer of the atomics in the usual case; readers only ever load them, except
+// for the window min/max, which Interval_reset restarts.
 typedef struct {
-    struct timespec lastTime; // Timestamp of the previous mark
-    double min; // Minimum interval seen (milliseconds)
-    double max; // Maximum interval seen (milliseconds)
-    double sum; // Accumulator for calculating average
-    int count;  // Number of samples collected
-    int firstCall; // Flag to ignore the very first call (setup time)
-} IntervalStats;
+    atomic_ullong counts[NUM_BUCKETS];
+    atomic_ullong sum;          // ns
+    atomic_ullong windowMin;
+    atomic_ullong windowMax;
+    atomic_ullong lifetimeMin;
+    atomic_ullong lifetimeMax;
+
+    long long lastMarkNs;       // Previous Interval_mark (owning thread only, 0 = none yet)
+
+    // Lifetime totals at the start of the current window (readers only, under s_readMutex)
+    unsigned long long baseCounts[NUM_BUCKETS];
+    unsigned long long baseSum;
+} IntervalLane;
 
 // --- Internal State ---
 
-static IntervalStats s_intervals[NUM_INTERVALS];
-static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Built-in types first, then the ones added with Interval_register
+static char s_names[INTERVAL_MAX_TYPES][MAX_NAME_LEN] = {
+    [INTERVAL_AUDIO] = "audio",
+    [INTERVAL_ACCEL] = "accel",
+    [INTERVAL_LATENCY] = "latency",
+    [INTERVAL_DSP_LOAD] = "dsp",
+};
+static atomic_int s_numTypes = NUM_INTERVALS;
+
+// Lanes of each type, allocated the first time a thread records that type. They
+// live until the process exits, since threads may still record after cleanup.
+static IntervalLane *_Atomic s_lanes[INTERVAL_MAX_TYPES][MAX_LANES];
+static atomic_int s_numLanes[INTERVAL_MAX_TYPES];
+static pthread_mutex_t s_laneMutex = PTHREAD_MUTEX_INITIALIZER;   // Lane and type allocation only
+
+// This thread's lane of each type
+static _Thread_local IntervalLane *t_lanes[INTERVAL_MAX_TYPES];
+
+// Serializes readers (reset/stats); recording never takes it
+static pthread_mutex_t s_readMutex = PTHREAD_MUTEX_INITIALIZER;
 
 // --- Private Helpers ---
 
@@ -36,77 +86,242 @@ static long long timespecToNano(struct timespec t) {
     return t.tv_sec * 1000000000LL + t.tv_nsec;
 }
 
+static int bucketOf(unsigned long long value) {
+    if (value >= (1ULL << MAX_VALUE_BITS)) {
+        value = (1ULL << MAX_VALUE_BITS) - 1;
+    }
+    if (value < SUB_BUCKETS) {
+        return (int)value;
+    }
+    int shift = (63 - __builtin_clzll(value)) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+// Middle of the values that fall in 'bucket'
+static double bucketMidpoint(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return (double)bucket;
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    unsigned long long low = (unsigned long long)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return (double)low + (double)(1ULL << shift) / 2.0;
+}
+
+static IntervalLane* newLane(IntervalType type) {
+    pthread_mutex_lock(&s_laneMutex);
+    IntervalLane *pLane = NULL;
+    int numLanes = atomic_load(&s_numLanes[type]);
+    if (numLanes < MAX_LANES) {
+        pLane = calloc(1, sizeof(*pLane));
+    }
+    if (pLane) {
+        atomic_init(&pLane->windowMin, ULLONG_MAX);
+        atomic_init(&pLane->lifetimeMin, ULLONG_MAX);
+        atomic_store(&s_lanes[type][numLanes], pLane);
+        atomic_store(&s_numLanes[type], numLanes + 1);
+    } else {
+        // Out of lanes: share the last one (all updates are atomic, so still correct)
+        pLane = atomic_load(&s_lanes[type][numLanes - 1]);
+    }
+    pthread_mutex_unlock(&s_laneMutex);
+    return pLane;
+}
+
+static IntervalLane* laneOf(IntervalType type) {
+    IntervalLane *pLane = t_lanes[type];
+    if (!pLane) {
+        pLane = t_lanes[type] = newLane(type);
+    }
+    return pLane;
+}
+
+static void storeMin(atomic_ullong *pMin, unsigned long long value) {
+    unsigned long long old = atomic_load_explicit(pMin, memory_order_relaxed);
+    while (value < old && !atomic_compare_exchange_weak_explicit(pMin, &old, value,
+                                                                 memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void storeMax(atomic_ullong *pMax, unsigned long long value) {
+    unsigned long long old = atomic_load_explicit(pMax, memory_order_relaxed);
+    while (value > old && !atomic_compare_exchange_weak_explicit(pMax, &old, value,
+                                                                 memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void recordNs(IntervalLane *pLane, unsigned long long value) {
+    atomic_fetch_add_explicit(&pLane->counts[bucketOf(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&pLane->sum, value, memory_order_relaxed);
+    storeMin(&pLane->windowMin, value);
+    storeMax(&pLane->windowMax, value);
+    storeMin(&pLane->lifetimeMin, value);
+    storeMax(&pLane->lifetimeMax, value);
+}
+
+// Merge every lane of 'type' over 'window'. Call with s_readMutex held.
+// Returns the number of samples; the histogram lands in 'counts'.
+static unsigned long long mergeLanes(IntervalType type, IntervalWindow window,
+                                     unsigned long long *counts, IntervalSummary *pSummary) {
+    unsigned long long total = 0, sum = 0;
+    unsigned long long min = ULLONG_MAX, max = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        counts[b] = 0;
+    }
+
+    int numLanes = atomic_load(&s_numLanes[type]);
+    for (int i = 0; i < numLanes; i++) {
+        IntervalLane *pLane = atomic_load(&s_lanes[type][i]);
+        bool lifetime = (window == INTERVAL_WINDOW_LIFETIME);
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            unsigned long long n = atomic_load_explicit(&pLane->counts[b], memory_order_relaxed);
+            counts[b] += lifetime ? n : n - pLane->baseCounts[b];
+        }
+        unsigned long long laneSum = atomic_load_explicit(&pLane->sum, memory_order_relaxed);
+        sum += lifetime ? laneSum : laneSum - pLane->baseSum;
+
+        unsigned long long laneMin = atomic_load(lifetime ? &pLane->lifetimeMin : &pLane->windowMin);
+        unsigned long long laneMax = atomic_load(lifetime ? &pLane->lifetimeMax : &pLane->windowMax);
+        if (laneMin < min) min = laneMin;
+        if (laneMax > max) max = laneMax;
+    }
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        total += counts[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    // A sample can land between reading the buckets and the min/max; keep them consistent
+    if (min == ULLONG_MAX) min = 0;
+    if (max < min) max = min;
+
+    pSummary->count = total;
+    pSummary->min = min / NS_PER_MS;
+    pSummary->max = max / NS_PER_MS;
+    pSummary->avg = (double)sum / (double)total / NS_PER_MS;
+    return total;
+}
+
+// Value below which 'fraction' of the samples fall (bucket midpoint, within min..max)
+static double percentile(const unsigned long long *counts, unsigned long long total,
+                         double fraction, const IntervalSummary *pSummary) {
+    unsigned long long rank = (unsigned long long)(fraction * (double)total + 0.999999);
+    if (rank < 1) rank = 1;
+    unsigned long long seen = 0;
+    for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            double value = bucketMidpoint(b) / NS_PER_MS;
+            if (value < pSummary->min) value = pSummary->min;
+            if (value > pSummary->max) value = pSummary->max;
+            return value;
+        }
+    }
+    return pSummary->max;
+}
+
 // --- Public API ---
 
 void Interval_init(void) {
-    for (int i = 0; i < NUM_INTERVALS; i++) {
+    for (int i = 0; i < Interval_getCount(); i++) {
         Interval_reset(i);
     }
 }
 
 void Interval_cleanup(void) {
-    // No dynamic memory to free
+    // Lanes are kept: the audio thread may still be recording
+}
+
+IntervalType Interval_register(const char *name) {
+    pthread_mutex_lock(&s_laneMutex);
+    int numTypes = atomic_load(&s_numTypes);
+    int type = 0;
+    while (type < numTypes && strncmp(s_names[type], name, MAX_NAME_LEN - 1) != 0) {
+        type++;
+    }
+    if (type == numTypes) {
+        if (numTypes == INTERVAL_MAX_TYPES) {
+            LOG_LIMITED(LOG_LEVEL_WARN, "IntervalTimer: WARNING: No room for '%s' (%d types max).", name, INTERVAL_MAX_TYPES);
+            type = -1;
+        } else {
+            snprintf(s_names[type], MAX_NAME_LEN, "%s", name);
+            atomic_store(&s_numTypes, numTypes + 1);
+        }
+    }
+    pthread_mutex_unlock(&s_laneMutex);
+    return (IntervalType)type;
+}
+
+int Interval_getCount(void) {
+    return atomic_load(&s_numTypes);
+}
+
+const char* Interval_getName(IntervalType type) {
+    return s_names[type];
 }
 
 void Interval_reset(IntervalType type) {
-    pthread_mutex_lock(&s_mutex);
-    
-    // Reset stats to extremes so the first real sample overwrites them
-    s_intervals[type].min = 1.0e9; 
-    s_intervals[type].max = 0;
-    s_intervals[type].sum = 0;
-    s_intervals[type].count = 0;
-    
-    // Mark next call as the "first" (reference) call
-    s_intervals[type].firstCall = 1;
-    clock_gettime(CLOCK_MONOTONIC, &s_intervals[type].lastTime);
-    
-    pthread_mutex_unlock(&s_mutex);
+    pthread_mutex_lock(&s_readMutex);
+
+    // Start a new window at the lifetime totals as they are now
+    int numLanes = atomic_load(&s_numLanes[type]);
+    for (int i = 0; i < numLanes; i++) {
+        IntervalLane *pLane = atomic_load(&s_lanes[type][i]);
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            pLane->baseCounts[b] = atomic_load_explicit(&pLane->counts[b], memory_order_relaxed);
+        }
+        pLane->baseSum = atomic_load_explicit(&pLane->sum, memory_order_relaxed);
+        atomic_store(&pLane->windowMin, ULLONG_MAX);
+        atomic_store(&pLane->windowMax, 0);
+    }
+
+    pthread_mutex_unlock(&s_readMutex);
 }
 
 void Interval_mark(IntervalType type) {
     struct timespec currentTime;
     clock_gettime(CLOCK_MONOTONIC, &currentTime);
+    long long nowNs = timespecToNano(currentTime);
 
-    pthread_mutex_lock(&s_mutex);
-    
-    if (s_intervals[type].firstCall) {
-        // First time calling: just store the time as a reference point.
-        // We can't calculate an interval (delta) yet.
-        s_intervals[type].firstCall = 0;
-        s_intervals[type].lastTime = currentTime;
-    } else {
-        // Calculate time passed since last mark
-        long long diff = timespecToNano(currentTime) - timespecToNano(s_intervals[type].lastTime);
-        double diffMs = (double)diff / 1000000.0;
-
-        // Update statistics
-        if (diffMs < s_intervals[type].min) s_intervals[type].min = diffMs;
-        if (diffMs > s_intervals[type].max) s_intervals[type].max = diffMs;
-        s_intervals[type].sum += diffMs;
-        s_intervals[type].count++;
-        
-        // Update reference for next time
-        s_intervals[type].lastTime = currentTime;
+    IntervalLane *pLane = laneOf(type);
+    if (pLane->lastMarkNs != 0) {
+        // Time passed since this thread's last mark
+        long long diff = nowNs - pLane->lastMarkNs;
+        recordNs(pLane, (diff > 0) ? (unsigned long long)diff : 0);
     }
-    
-    pthread_mutex_unlock(&s_mutex);
+    // The first mark is only a reference point: no interval to record yet
+    pLane->lastMarkNs = nowNs;
+}
+
+void Interval_record(IntervalType type, double ms) {
+    double ns = ms * NS_PER_MS;
+    recordNs(laneOf(type), (ns > 0) ? (unsigned long long)(ns + 0.5) : 0);
 }
 
 int Interval_getStats(IntervalType type, double* min, double* max, double* avg, int* count) {
-    pthread_mutex_lock(&s_mutex);
-    
-    // If no data collected, return failure (0)
-    if (s_intervals[type].count == 0) {
-        pthread_mutex_unlock(&s_mutex);
-        return 0;
+    IntervalSummary summary;
+    if (!Interval_getSummary(type, INTERVAL_WINDOW_CURRENT, &summary)) {
+        return 0; // No data collected
     }
-
-    *min = s_intervals[type].min;
-    *max = s_intervals[type].max;
-    *count = s_intervals[type].count;
-    *avg = s_intervals[type].sum / (double)(*count);
-    
-    pthread_mutex_unlock(&s_mutex);
+    *min = summary.min;
+    *max = summary.max;
+    *avg = summary.avg;
+    *count = (summary.count > INT_MAX) ? INT_MAX : (int)summary.count;
     return 1;
-}
\ No newline at end of file
+}
+
+int Interval_getSummary(IntervalType type, IntervalWindow window, IntervalSummary *pSummary) {
+    // Merged histogram (static: readers are serialized, and it is too big for the stack)
+    static unsigned long long counts[NUM_BUCKETS];
+
+    pthread_mutex_lock(&s_readMutex);
+    unsigned long long total = mergeLanes(type, window, counts, pSummary);
+    if (total > 0) {
+        pSummary->p50 = percentile(counts, total, 0.50, pSummary);
+        pSummary->p90 = percentile(counts, total, 0.90, pSummary);
+        pSummary->p99 = percentile(counts, total, 0.99, pSummary);
+        pSummary->p999 = percentile(counts, total, 0.999, pSummary);
+    }
+    pthread_mutex_unlock(&s_readMutex);
+    return total > 0;
+}
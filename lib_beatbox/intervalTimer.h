@@ -5,22 +5,65 @@
 typedef enum {
     INTERVAL_AUDIO, // Time between audio buffer refills
     INTERVAL_ACCEL, // Time between accelerometer polls
-    NUM_INTERVALS   // Total count (Keep at end)
+    INTERVAL_LATENCY, // Trigger-to-DAC latency of immediate triggers (see Interval_record)
+    INTERVAL_DSP_LOAD, // Render time of each audio period, in percent of the period (see Interval_record)
+    NUM_INTERVALS   // Total count of built-in types (Keep at end; see Interval_register)
 } IntervalType;
 
+// Built-in plus registered types
+#define INTERVAL_MAX_TYPES 32
+
+// Which samples a summary covers
+typedef enum {
+    INTERVAL_WINDOW_CURRENT,  // Since the last Interval_reset (the status line resets every second)
+    INTERVAL_WINDOW_LIFETIME  // Since the program started
+} IntervalWindow;
+
+// Statistics of one interval type over one window, in milliseconds (or whatever
+// unit was handed to Interval_record). Percentiles are accurate to ~1.6%.
+typedef struct {
+    unsigned long long count;
+    double min;
+    double max;
+    double avg;
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+} IntervalSummary;
+
 void Interval_init(void);
 void Interval_cleanup(void);
 
-// Resets the statistics for a specific interval type.
+// Add a named type (or find the one already registered under 'name'). Its ID is
+// used like a built-in type's. Returns -1 once INTERVAL_MAX_TYPES are in use.
+// See probe.h for the usual way to create them.
+IntervalType Interval_register(const char *name);
+
+// Number of types (valid IDs are 0 .. count-1).
+int Interval_getCount(void);
+
+// Short name of an interval type (e.g. "audio"), for reports.
+const char* Interval_getName(IntervalType type);
+
+// Starts a new current window for a specific interval type (the lifetime stats are kept).
 // Typically called after printing stats to start a fresh second.
 void Interval_reset(IntervalType type);
 
 // Call this function every time the event happens.
-// It tracks the time difference between this call and the previous one.
+// It tracks the time difference between this call and the previous one on the same thread.
+// Lock-free: marking and recording never wait for another thread.
 void Interval_mark(IntervalType type);
 
+// Record a measured duration directly (for values that are not the gap between marks).
+void Interval_record(IntervalType type, double ms);
+
 // Retrieves the current statistics.
 // Returns 1 if data is available, 0 if no samples have been collected.
 int Interval_getStats(IntervalType type, double* min, double* max, double* avg, int* count);
 
+// Retrieves min, max, average and p50/p90/p99/p99.9 over a window.
+// Returns 1 if data is available, 0 if no samples have been collected.
+int Interval_getSummary(IntervalType type, IntervalWindow window, IntervalSummary *pSummary);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,249 @@
+/*
+ * Logger Module
+ * * Keeps console (or log file) output off the threads that must not stall. Callers
+ * format their message straight into a cell of a bounded lock-free queue and return;
+ * a low-priority writer thread prints the queued lines. A slow SSH session or a full
+ * pipe then only ever blocks the writer.
+ * * The queue is the same Vyukov-style multi-producer / single-consumer ring as the
+ * trigger queue: a producer claims a cell with one CAS, fills it, and publishes it
+ * by bumping the cell's sequence. When it is full the message is dropped and counted.
+ */
+
+#include "logger.h"
+#include "rtProfile.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <time.h>
+
+// --- Configuration Constants ---
+
+#define QUEUE_MASK (LOG_QUEUE_SIZE - 1)
+#define CACHE_LINE_SIZE 64
+#define FLUSH_PERIOD_MS 20   // How often the writer looks for new messages
+
+#if (LOG_QUEUE_SIZE & QUEUE_MASK) != 0
+#error "LOG_QUEUE_SIZE must be a power of 2"
+#endif
+
+// --- Internal State ---
+
+typedef struct {
+    atomic_size_t sequence; // == position when free, position + 1 when published
+    LogLevel level;
+    char text[LOG_MESSAGE_LEN];
+} logCell_t;
+
+static logCell_t s_cells[LOG_QUEUE_SIZE];
+static atomic_size_t s_enqueuePos __attribute__((aligned(CACHE_LINE_SIZE)));
+static size_t s_dequeuePos __attribute__((aligned(CACHE_LINE_SIZE))); // Writer-owned
+static atomic_ulong s_droppedCount __attribute__((aligned(CACHE_LINE_SIZE)));
+
+static const char *s_levelNames[NUM_LOG_LEVELS] = { "debug", "info", "warn", "error" };
+static atomic_int s_minLevel = LOG_LEVEL_INFO;
+
+static FILE *s_pFile = NULL;           // Log file, or NULL for the console
+static atomic_bool s_running = false;  // Writer thread owns the output
+static volatile bool s_stopping = false;
+static pthread_t s_writerThreadId;
+
+// --- Private Helpers ---
+
+static long long nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static void writeLine(LogLevel level, const char *text)
+{
+    FILE *pOut = s_pFile ? s_pFile : (level >= LOG_LEVEL_ERROR) ? stderr : stdout;
+    fputs(text, pOut);
+    fputc('\n', pOut);
+}
+
+// Claim a free cell. NULL (and counted) if the queue is full.
+static logCell_t* claimCell(size_t *pPos)
+{
+    logCell_t *cell;
+    size_t pos = atomic_load_explicit(&s_enqueuePos, memory_order_relaxed);
+
+    for (;;) {
+        cell = &s_cells[pos & QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&s_enqueuePos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                *pPos = pos;
+                return cell;
+            }
+        } else if (diff < 0) {
+            // The writer has not caught up: drop rather than wait
+            atomic_fetch_add_explicit(&s_droppedCount, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&s_enqueuePos, memory_order_relaxed);
+        }
+    }
+}
+
+// Print every published message. Returns true if there were any.
+static bool drainQueue(void)
+{
+    bool wroteAny = false;
+    for (;;) {
+        logCell_t *cell = &s_cells[s_dequeuePos & QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(s_dequeuePos + 1) < 0) {
+            break; // Empty, or a producer is still formatting
+        }
+        writeLine(cell->level, cell->text);
+        atomic_store_explicit(&cell->sequence, s_dequeuePos + LOG_QUEUE_SIZE, memory_order_release);
+        s_dequeuePos++;
+        wroteAny = true;
+    }
+    return wroteAny;
+}
+
+static void* writerThread(void* _arg)
+{
+    (void)_arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_BACKGROUND, "log writer");
+
+    unsigned long reportedDrops = 0;
+    bool stopping = false;
+    while (!stopping) {
+        stopping = s_stopping; // Drain once more after the stop request
+        bool wroteAny = drainQueue();
+
+        unsigned long drops = atomic_load_explicit(&s_droppedCount, memory_order_relaxed);
+        if (drops != reportedDrops) {
+            fprintf(s_pFile ? s_pFile : stdout, "Log: %lu message(s) dropped (queue full).\n", drops - reportedDrops);
+            reportedDrops = drops;
+            wroteAny = true;
+        }
+        if (wroteAny) {
+            fflush(s_pFile ? s_pFile : stdout);
+        }
+        if (!stopping) {
+            struct timespec delay = { 0, FLUSH_PERIOD_MS * 1000000L };
+            nanosleep(&delay, NULL);
+        }
+    }
+    return NULL;
+}
+
+// --- Public API ---
+
+bool Log_init(const char *path)
+{
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+        atomic_store_explicit(&s_cells[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&s_enqueuePos, 0, memory_order_relaxed);
+    s_dequeuePos = 0;
+
+    bool ok = true;
+    if (path) {
+        s_pFile = fopen(path, "a");
+        if (!s_pFile) {
+            perror("Log: Failed to open log file");
+            ok = false;
+        }
+    }
+
+    s_stopping = false;
+    if (pthread_create(&s_writerThreadId, NULL, writerThread, NULL) != 0) {
+        printf("Log: Could not start the writer thread; logging synchronously.\n");
+        return ok;
+    }
+    atomic_store(&s_running, true);
+    return ok;
+}
+
+void Log_cleanup(void)
+{
+    if (atomic_load(&s_running)) {
+        // Late messages are written directly; the writer drains what is queued
+        atomic_store(&s_running, false);
+        s_stopping = true;
+        pthread_join(s_writerThreadId, NULL);
+    }
+    if (s_pFile) {
+        fclose(s_pFile);
+        s_pFile = NULL;
+    }
+}
+
+void Log_setLevel(LogLevel level)
+{
+    atomic_store(&s_minLevel, (int)level);
+}
+
+bool Log_parseLevel(const char *name, LogLevel *pLevel)
+{
+    for (int i = 0; i < NUM_LOG_LEVELS; i++) {
+        if (strcasecmp(name, s_levelNames[i]) == 0) {
+            *pLevel = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Log_write(LogLevel level, const char *format, ...)
+{
+    if ((int)level < atomic_load_explicit(&s_minLevel, memory_order_relaxed)) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    if (!atomic_load_explicit(&s_running, memory_order_acquire)) {
+        // No writer thread (yet): write it ourselves
+        char text[LOG_MESSAGE_LEN];
+        vsnprintf(text, sizeof(text), format, args);
+        writeLine(level, text);
+        fflush(s_pFile ? s_pFile : stdout);
+    } else {
+        size_t pos;
+        logCell_t *cell = claimCell(&pos);
+        if (cell) {
+            cell->level = level;
+            vsnprintf(cell->text, LOG_MESSAGE_LEN, format, args);
+            atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+        }
+    }
+    va_end(args);
+}
+
+unsigned long Log_getDroppedCount(void)
+{
+    return atomic_load_explicit(&s_droppedCount, memory_order_relaxed);
+}
+
+bool Log_allow(logLimit_t *pLimit)
+{
+    long long now = nowNs();
+    long long start = atomic_load_explicit(&pLimit->windowStartNs, memory_order_relaxed);
+    if (now - start >= LOG_LIMIT_WINDOW_MS * 1000000LL
+            && atomic_compare_exchange_strong(&pLimit->windowStartNs, &start, now)) {
+        // New window: this thread won the race to open it
+        atomic_store(&pLimit->count, 0);
+        unsigned long suppressed = atomic_exchange(&pLimit->suppressed, 0);
+        if (suppressed > 0) {
+            Log_write(LOG_LEVEL_WARN, "Log: %lu similar message(s) suppressed.", suppressed);
+        }
+    }
+    if (atomic_fetch_add_explicit(&pLimit->count, 1, memory_order_relaxed) < LOG_LIMIT_BURST) {
+        return true;
+    }
+    atomic_fetch_add_explicit(&pLimit->suppressed, 1, memory_order_relaxed);
+    return false;
+}
@@ -0,0 +1,66 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Longest message kept (longer ones are truncated)
+#define LOG_MESSAGE_LEN 512
+
+// Messages waiting to be written; past this they are dropped (and counted). A power of two.
+#define LOG_QUEUE_SIZE 256
+
+// Rate limit of LOG_LIMITED: at most this many messages per call site per window
+#define LOG_LIMIT_BURST     5
+#define LOG_LIMIT_WINDOW_MS 1000
+
+typedef enum {
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR,   // Written to stderr when logging to the console
+    NUM_LOG_LEVELS     // Total count (Keep at end)
+} LogLevel;
+
+// Start the writer thread. Messages go to 'path' (appended), or to the console if
+// NULL. Until then (and after Log_cleanup) messages are written directly by the caller.
+// Returns false if the file cannot be opened (the console is used instead).
+bool Log_init(const char *path);
+
+// Write out everything still queued and stop the writer thread.
+void Log_cleanup(void);
+
+// Messages below 'level' are discarded (default LOG_LEVEL_INFO).
+void Log_setLevel(LogLevel level);
+bool Log_parseLevel(const char *name, LogLevel *pLevel);
+
+// Format one line (no trailing newline needed) into the queue and return at once.
+// Never blocks and takes no lock: if the queue is full the message is dropped and counted.
+void Log_write(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Messages dropped because the queue was full.
+unsigned long Log_getDroppedCount(void);
+
+// --- Rate limiting ---
+
+// State of one LOG_LIMITED call site
+typedef struct {
+    atomic_llong windowStartNs;
+    atomic_int count;
+    atomic_ulong suppressed;
+} logLimit_t;
+
+// True if the call site may log now. Reports how many messages it held back
+// once its next window opens.
+bool Log_allow(logLimit_t *pLimit);
+
+// Log_write, but at most LOG_LIMIT_BURST times per LOG_LIMIT_WINDOW_MS from this call
+// site: for messages that can repeat on every period (e.g. a failing device).
+#define LOG_LIMITED(level, ...) do { \
+        static logLimit_t s_logLimit; \
+        if (Log_allow(&s_logLimit)) { \
+            Log_write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#endif
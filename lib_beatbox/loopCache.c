@@ -0,0 +1,469 @@
+/*
+ * Loop Cache Module
+ * * Pre-mixes one full pass of the current drum pattern at the current tempo, so
+ * the mixer plays a bar as a single voice instead of one voice per hit. The beat
+ * generator schedules the bar on the pattern's first step; ad-hoc hits from UDP
+ * or the accelerometer are still mixed live on top.
+ * * Design:
+ * - Rendering runs on a background thread. The sequencer asks for the loop it
+ *   wants (pattern, tempo, kit generation) and keeps playing live until it is ready,
+ *   so a tempo, mode or kit change never waits for a render.
+ * - A loop holds three sounds: the bar with the previous pass's tails folded in
+ *   (steady state), the bar without them (the pass before was live and its voices
+ *   are still ringing), and the tail alone (the pass after is live). Together they
+ *   hand over seamlessly in both directions at a bar boundary. Each also comes one
+ *   frame longer, for the passes the step clock rounds up.
+ * - Hits are mixed exactly as the mixer would play them: centre pan, and choke
+ *   groups fade a voice out when the next hit of its group starts (including the
+ *   hits of the next pass, which ring into this one).
+ * - Coincident hits can add up past 16 bits where the mixer's 32-bit accumulator
+ *   would not clip. Such a loop is stored at half level and queued as two voices.
+ * - Each loop is its own audioKit_t, so it is retired the same way as a drum kit:
+ *   freed only once no voice plays from it.
+ */
+
+#include "loopCache.h"
+#include "beatPattern.h"
+#include "logger.h"
+#include "sampleBank.h"
+#include "voiceAllocator.h"
+#include "mixKernel.h"
+#include "rtProfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+// --- Configuration Constants ---
+
+#define RETIRE_POLL_MS 5 // How often a handed-back loop is checked for being out of use
+#define NS_PER_MS 1000000LL
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Two passes of the longest pattern with every instrument on every step
+#define MAX_HITS (2 * BEATPATTERN_MAX_STEPS * BEATPATTERN_MAX_INSTRUMENTS)
+
+// --- Internal State ---
+
+typedef struct {
+    int frame;      // Offset from the start of the first pass
+    int soundId;
+    int chokeGroup;
+} loopHit_t;
+
+static bool s_enabled = true;
+static bool s_started = false;
+static pthread_t s_threadId;
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_wake = PTHREAD_COND_INITIALIZER;
+static bool s_stopping = false;
+
+// Latest request from the sequencer (protected by the mutex)
+static int s_reqMode = -1;
+static int s_reqTempo = 0;
+static unsigned int s_reqGeneration = 0;
+static bool s_reqPending = false;
+
+static patternLoop_t *s_pReady = NULL;   // Rendered for the latest request, not taken yet
+static patternLoop_t *s_pRetired = NULL; // Handed back, waiting for their voices to end
+
+// Render thread only
+static loopHit_t s_hits[MAX_HITS];
+static int32_t s_centreGainQ15 = 0;
+
+// --- Private Helpers ---
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Frames from the start of a pass to 'step', with the beat generator's step formula.
+// The generator counts from its epoch instead, so there a pass spans this many frames
+// for 'step' = numSteps, or one more, and each hit may land one frame later.
+static int stepOffset(long long step, int tempo, int stepsPerBeat)
+{
+    return (int)((unsigned long long)step * AUDIOMIXER_SAMPLE_RATE * 60ULL
+                 / ((unsigned long long)tempo * (unsigned long long)stepsPerBeat));
+}
+
+static bool fits16(int32_t v)
+{
+    return v >= INT16_MIN && v <= INT16_MAX;
+}
+
+static void freeLoop(patternLoop_t *pLoop)
+{
+    if (pLoop) {
+        free(pLoop->pLinear);
+        free(pLoop->pLoop);
+        free(pLoop);
+    }
+}
+
+// Free every retired loop the mixer no longer plays. Call with the mutex held.
+static void freeIdleLoops(void)
+{
+    patternLoop_t **ppLoop = &s_pRetired;
+    while (*ppLoop) {
+        patternLoop_t *pLoop = *ppLoop;
+        if (AudioMixer_isKitIdle(&pLoop->kit)) {
+            *ppLoop = pLoop->pNext;
+            freeLoop(pLoop);
+        } else {
+            ppLoop = &pLoop->pNext;
+        }
+    }
+}
+
+// Mix one hit at centre pan. From 'releaseAt' frames in, it fades out the way the
+// mixer fades a choked voice.
+static void mixHit(int32_t *pAcc, const short *pSrc, int length, int releaseAt)
+{
+    int hold = (releaseAt < length) ? releaseAt : length;
+    for (int i = 0; i < hold; i++) {
+        pAcc[i] += (pSrc[i] * s_centreGainQ15) >> 15;
+    }
+
+    int releaseFrames = VOICEALLOC_RELEASE_FRAMES;
+    for (int i = hold; i < length && releaseFrames > 0; ) {
+        int32_t scaleQ15 = releaseFrames * MIXKERNEL_UNITY_Q15 / VOICEALLOC_RELEASE_FRAMES;
+        int32_t gain = (s_centreGainQ15 * scaleQ15) >> 15;
+        int n = length - i;
+        if (n > VOICEALLOC_RELEASE_STEP_FRAMES) n = VOICEALLOC_RELEASE_STEP_FRAMES;
+        if (n > releaseFrames) n = releaseFrames;
+        for (int k = 0; k < n; k++) {
+            pAcc[i + k] += (pSrc[i + k] * gain) >> 15;
+        }
+        i += n;
+        releaseFrames -= n;
+    }
+}
+
+// Render pattern 'mode' at 'tempo' from the current kit, if it still is 'generation'.
+// Returns NULL if the pattern has no hits, is too long, or the kit has changed.
+static patternLoop_t* renderLoop(int mode, int tempo, unsigned int generation)
+{
+    const beatPattern_t *pPattern = BeatPattern_get(mode);
+    if (!pPattern) {
+        return NULL;
+    }
+    int barFrames = stepOffset(pPattern->numSteps, tempo, pPattern->stepsPerBeat);
+    if (barFrames <= 0 || barFrames > LOOPCACHE_MAX_SECONDS * AUDIOMIXER_SAMPLE_RATE) {
+        return NULL;
+    }
+
+    // Pin the kit and map the pattern's instruments onto it. If the kit changed in
+    // between, the IDs may belong to another kit: give up (a new request follows).
+    unsigned int kitGeneration;
+    audioKit_t *pKit = SampleBank_acquireKit(&kitGeneration);
+    int slotIds[BEATPATTERN_MAX_INSTRUMENTS];
+    int slotChokes[BEATPATTERN_MAX_INSTRUMENTS];
+    for (int slot = 0; slot < BeatPattern_getNumInstruments(); slot++) {
+        slotIds[slot] = SampleBank_findByName(BeatPattern_getInstrumentName(slot));
+        slotChokes[slot] = SampleBank_getChokeGroup(slotIds[slot]);
+    }
+    if (!pKit || kitGeneration != generation || SampleBank_getGeneration() != generation) {
+        SampleBank_releaseKit(pKit);
+        return NULL;
+    }
+
+    // List the hits of two passes in the order the sequencer queues them. Only the
+    // first pass is mixed; the second one only chokes its tails.
+    int numHits = 0;
+    int numFirstPass = 0;
+    int linearFrames = barFrames;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int step = 0; step < pPattern->numSteps; step++) {
+            int frame = pass * barFrames + stepOffset(step, tempo, pPattern->stepsPerBeat);
+            uint32_t hits = pPattern->stepInstruments[step];
+            while (hits) {
+                int slot = __builtin_ctz(hits);
+                hits &= hits - 1;
+                int id = slotIds[slot];
+                if (id < 0 || id >= pKit->numSounds) {
+                    continue;
+                }
+                s_hits[numHits++] = (loopHit_t){ frame, id, slotChokes[slot] };
+                if (pass == 0) {
+                    int end = frame + pKit->pSounds[id].numSamples;
+                    if (end > linearFrames) linearFrames = end;
+                }
+            }
+        }
+        if (pass == 0) {
+            numFirstPass = numHits;
+        }
+    }
+
+    patternLoop_t *pLoop = NULL;
+    int32_t *pAcc = NULL;
+    if (numFirstPass > 0) {
+        pLoop = calloc(1, sizeof(*pLoop));
+        pAcc = calloc((size_t)linearFrames + 1, sizeof(int32_t)); // + a silent frame for long passes
+    }
+    if (!pLoop || !pAcc) {
+        SampleBank_releaseKit(pKit);
+        free(pLoop);
+        free(pAcc);
+        return NULL;
+    }
+
+    for (int h = 0; h < numFirstPass; h++) {
+        const wavedata_t *pSound = &pKit->pSounds[s_hits[h].soundId];
+        int releaseAt = pSound->numSamples;
+        if (s_hits[h].chokeGroup > 0) {
+            for (int j = h + 1; j < numHits; j++) {
+                if (s_hits[j].chokeGroup == s_hits[h].chokeGroup) {
+                    releaseAt = s_hits[j].frame - s_hits[h].frame;
+                    break;
+                }
+            }
+        }
+        mixHit(pAcc + s_hits[h].frame, pSound->pData, pSound->numSamples, releaseAt);
+    }
+    SampleBank_releaseKit(pKit);
+
+    // One pass then its tail as played, and the same pass with the tail wrapped around
+    // onto it (a tail may be longer than a pass)
+    bool fits = true;
+    for (int i = 0; i < linearFrames; i++) {
+        fits = fits && fits16(pAcc[i]);
+    }
+    int32_t *pWrapped = malloc(((size_t)barFrames + 1) * sizeof(int32_t));
+    pLoop->pLinear = malloc(((size_t)linearFrames + 1) * sizeof(short));
+    pLoop->pLoop = malloc(((size_t)barFrames + 1) * sizeof(short));
+    if (!pWrapped || !pLoop->pLinear || !pLoop->pLoop) {
+        freeLoop(pLoop);
+        free(pWrapped);
+        free(pAcc);
+        return NULL;
+    }
+    // (Frame barFrames only plays in a long pass: the tails, before the next pass starts.)
+    for (int i = 0; i <= barFrames; i++) {
+        int32_t sum = pAcc[i];
+        for (int j = i + barFrames; j <= linearFrames; j += barFrames) {
+            sum += pAcc[j];
+        }
+        pWrapped[i] = sum;
+        fits = fits && fits16(sum);
+    }
+
+    // Half level loses the lowest bit, so only use it when needed
+    int shift = fits ? 0 : 1;
+    for (int i = 0; i <= linearFrames; i++) {
+        pLoop->pLinear[i] = (short)(pAcc[i] >> shift);
+    }
+    for (int i = 0; i <= barFrames; i++) {
+        pLoop->pLoop[i] = (short)(pWrapped[i] >> shift);
+    }
+    free(pWrapped);
+    free(pAcc);
+    pLoop->copies = 1 << shift;
+
+    pLoop->sounds[LOOP_SOUND_BAR].numSamples = barFrames;
+    pLoop->sounds[LOOP_SOUND_BAR].pData = pLoop->pLoop;
+    pLoop->sounds[LOOP_SOUND_FIRST_BAR].numSamples = barFrames;
+    pLoop->sounds[LOOP_SOUND_FIRST_BAR].pData = pLoop->pLinear;
+    pLoop->sounds[LOOP_SOUND_TAIL].numSamples = linearFrames - barFrames;
+    pLoop->sounds[LOOP_SOUND_TAIL].pData = pLoop->pLinear + barFrames;
+    pLoop->sounds[LOOP_SOUND_BAR_LONG].numSamples = barFrames + 1;
+    pLoop->sounds[LOOP_SOUND_BAR_LONG].pData = pLoop->pLoop;
+    pLoop->sounds[LOOP_SOUND_FIRST_BAR_LONG].numSamples = barFrames + 1;
+    pLoop->sounds[LOOP_SOUND_FIRST_BAR_LONG].pData = pLoop->pLinear;
+    pLoop->sounds[LOOP_SOUND_TAIL_LONG].numSamples = (linearFrames > barFrames) ? linearFrames - barFrames - 1 : 0;
+    pLoop->sounds[LOOP_SOUND_TAIL_LONG].pData = pLoop->pLinear + barFrames + 1;
+    pLoop->kit.numSounds = LOOP_NUM_SOUNDS;
+    pLoop->kit.pSounds = pLoop->sounds;
+    atomic_init(&pLoop->kit.activeVoices, 0);
+    pLoop->mode = mode;
+    pLoop->tempo = tempo;
+    pLoop->generation = generation;
+    pLoop->numSteps = pPattern->numSteps;
+    pLoop->barFrames = barFrames;
+    return pLoop;
+}
+
+static void* renderThread(void *arg)
+{
+    (void)arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_BACKGROUND, "loop render");
+
+    pthread_mutex_lock(&s_mutex);
+    while (!s_stopping) {
+        if (s_reqPending) {
+            int mode = s_reqMode;
+            int tempo = s_reqTempo;
+            unsigned int generation = s_reqGeneration;
+            s_reqPending = false;
+            pthread_mutex_unlock(&s_mutex);
+
+            long long startNs = nowNs();
+            patternLoop_t *pLoop = renderLoop(mode, tempo, generation);
+            if (pLoop) {
+                Log_write(LOG_LEVEL_INFO, "LoopCache: Rendered '%s' at %d BPM (%.2f s bar, %d voice%s) in %.1f ms.",
+                          BeatPattern_get(mode)->name, tempo, (double)pLoop->barFrames / AUDIOMIXER_SAMPLE_RATE,
+                          pLoop->copies, (pLoop->copies > 1) ? "s" : "", (nowNs() - startNs) / 1e6);
+            }
+
+            pthread_mutex_lock(&s_mutex);
+            // Publish it only if the sequencer still wants it. A loop that was never
+            // taken was never queued, so it can be freed right away.
+            if (pLoop && !s_reqPending && LoopCache_matches(pLoop, s_reqMode, s_reqTempo, s_reqGeneration)) {
+                patternLoop_t *pOld = s_pReady;
+                s_pReady = pLoop;
+                pLoop = pOld;
+            }
+            freeLoop(pLoop);
+            continue;
+        }
+
+        freeIdleLoops();
+        if (s_pRetired) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            long long ns = deadline.tv_nsec + RETIRE_POLL_MS * NS_PER_MS;
+            deadline.tv_sec += ns / 1000000000LL;
+            deadline.tv_nsec = ns % 1000000000LL;
+            pthread_cond_timedwait(&s_wake, &s_mutex, &deadline);
+        } else {
+            pthread_cond_wait(&s_wake, &s_mutex);
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return NULL;
+}
+
+// --- Public API ---
+
+void LoopCache_init(void)
+{
+    if (!s_enabled) {
+        printf("LoopCache: Disabled; patterns are mixed live.\n");
+        return;
+    }
+    s_centreGainQ15 = (int32_t)lrintf(cosf((float)M_PI / 4.0f) * MIXKERNEL_UNITY_Q15); // Mixer's centre pan
+    s_reqMode = -1;
+    s_reqPending = false;
+    s_stopping = false;
+    if (pthread_create(&s_threadId, NULL, renderThread, NULL) != 0) {
+        printf("LoopCache: Could not start the render thread; patterns are mixed live.\n");
+        return;
+    }
+    s_started = true;
+}
+
+void LoopCache_cleanup(void)
+{
+    if (!s_started) {
+        return;
+    }
+    pthread_mutex_lock(&s_mutex);
+    s_stopping = true;
+    pthread_cond_signal(&s_wake);
+    pthread_mutex_unlock(&s_mutex);
+    pthread_join(s_threadId, NULL);
+    s_started = false;
+
+    freeLoop(s_pReady);
+    s_pReady = NULL;
+
+    // Wait for the mixer to finish with the loops handed back
+    struct timespec pause = { 0, RETIRE_POLL_MS * NS_PER_MS };
+    for (;;) {
+        pthread_mutex_lock(&s_mutex);
+        freeIdleLoops();
+        bool done = (s_pRetired == NULL);
+        pthread_mutex_unlock(&s_mutex);
+        if (done) {
+            break;
+        }
+        nanosleep(&pause, NULL);
+    }
+}
+
+void LoopCache_setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+bool LoopCache_isEnabled(void)
+{
+    return s_enabled;
+}
+
+patternLoop_t* LoopCache_get(int mode, int tempo, unsigned int generation)
+{
+    if (!s_started) {
+        return NULL;
+    }
+
+    patternLoop_t *pLoop = NULL;
+    pthread_mutex_lock(&s_mutex);
+    if (s_pReady && LoopCache_matches(s_pReady, mode, tempo, generation)) {
+        pLoop = s_pReady;
+        s_pReady = NULL;
+    } else if (mode != s_reqMode || tempo != s_reqTempo || generation != s_reqGeneration) {
+        s_reqMode = mode;
+        s_reqTempo = tempo;
+        s_reqGeneration = generation;
+        s_reqPending = true;
+        pthread_cond_signal(&s_wake);
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return pLoop;
+}
+
+bool LoopCache_matches(const patternLoop_t *pLoop, int mode, int tempo, unsigned int generation)
+{
+    return pLoop->mode == mode && pLoop->tempo == tempo && pLoop->generation == generation;
+}
+
+void LoopCache_play(patternLoop_t *pLoop, LoopSound sound, unsigned long long startFrame)
+{
+    if (pLoop->sounds[sound].numSamples > 0) {
+        bool tail = (sound == LOOP_SOUND_TAIL || sound == LOOP_SOUND_TAIL_LONG);
+        int group = tail ? LOOPCACHE_CHOKE_GROUP_TAIL : LOOPCACHE_CHOKE_GROUP_BAR;
+        for (int i = 0; i < pLoop->copies; i++) {
+            AudioMixer_queuePinnedSoundAt(&pLoop->kit, (int)sound, startFrame, group);
+        }
+    }
+}
+
+void LoopCache_playBar(patternLoop_t *pLoop, bool continues,
+                       unsigned long long startFrame, unsigned long long endFrame)
+{
+    bool isLong = (endFrame - startFrame > (unsigned long long)pLoop->barFrames);
+    LoopSound sound;
+    if (continues) {
+        sound = isLong ? LOOP_SOUND_BAR_LONG : LOOP_SOUND_BAR;
+    } else {
+        sound = isLong ? LOOP_SOUND_FIRST_BAR_LONG : LOOP_SOUND_FIRST_BAR;
+    }
+    LoopCache_play(pLoop, sound, startFrame);
+}
+
+void LoopCache_playTail(patternLoop_t *pLoop, unsigned long long barStartFrame, unsigned long long endFrame)
+{
+    bool isLong = (endFrame - barStartFrame > (unsigned long long)pLoop->barFrames);
+    LoopCache_play(pLoop, isLong ? LOOP_SOUND_TAIL_LONG : LOOP_SOUND_TAIL, endFrame);
+}
+
+void LoopCache_release(patternLoop_t *pLoop)
+{
+    if (!pLoop) {
+        return;
+    }
+    pthread_mutex_lock(&s_mutex);
+    pLoop->pNext = s_pRetired;
+    s_pRetired = pLoop;
+    pthread_cond_signal(&s_wake);
+    pthread_mutex_unlock(&s_mutex);
+}
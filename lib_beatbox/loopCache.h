@@ -0,0 +1,77 @@
+#ifndef LOOPCACHE_H
+#define LOOPCACHE_H
+
+#include "audioMixer.h"
+#include <stdbool.h>
+
+// Patterns longer than this (at the requested tempo) are always played live
+#define LOOPCACHE_MAX_SECONDS 20
+
+// Choke groups reserved for loop voices (sound choke groups are small numbers)
+#define LOOPCACHE_CHOKE_GROUP_BAR  1000
+#define LOOPCACHE_CHOKE_GROUP_TAIL 1001
+
+// Sounds of a rendered loop. Each bar-length sound is exactly one pass of the pattern.
+// The step clock rounds from its epoch, so a pass lasts barFrames or barFrames + 1
+// frames; the _LONG sounds are the same data one frame longer.
+typedef enum {
+    LOOP_SOUND_BAR = 0,        // One pass, with the tails of the previous pass folded in
+    LOOP_SOUND_FIRST_BAR,      // One pass without them (the pass before was played live)
+    LOOP_SOUND_TAIL,           // What rings on past the end of a pass (the next one is played live)
+    LOOP_SOUND_BAR_LONG,
+    LOOP_SOUND_FIRST_BAR_LONG,
+    LOOP_SOUND_TAIL_LONG,      // The tail after a long pass
+    LOOP_NUM_SOUNDS
+} LoopSound;
+
+// One pattern pre-mixed at one tempo from one kit.
+typedef struct patternLoop {
+    audioKit_t kit;                        // The loop's sounds, pinned by every voice playing them
+    wavedata_t sounds[LOOP_NUM_SOUNDS];
+    int mode;
+    int tempo;
+    unsigned int generation;               // Sample bank generation it was rendered from
+    int numSteps;
+    int barFrames;
+    int copies;                            // Voices per play: 2 when stored at half level to fit 16 bits
+    short *pLinear;                        // One pass followed by its tail (plus one silent frame)
+    short *pLoop;                          // One pass with the tail folded in (plus one frame)
+    struct patternLoop *pNext;             // Retired list
+} patternLoop_t;
+
+// Start/stop the background render thread. LoopCache_cleanup waits until the mixer
+// has played out every loop handed back with LoopCache_release.
+void LoopCache_init(void);
+void LoopCache_cleanup(void);
+
+// Turn caching off (every pattern plays live). Call before LoopCache_init().
+void LoopCache_setEnabled(bool enabled);
+bool LoopCache_isEnabled(void);
+
+// Ask for pattern 'mode' at 'tempo' from kit 'generation'. Returns the loop once it
+// has been rendered (the caller then owns it), or NULL while it is being rendered,
+// if it cannot be cached (no hits, too long, kit changed) or caching is off.
+// Never blocks on the render.
+patternLoop_t* LoopCache_get(int mode, int tempo, unsigned int generation);
+
+// True if 'pLoop' was rendered for this pattern, tempo and kit.
+bool LoopCache_matches(const patternLoop_t *pLoop, int mode, int tempo, unsigned int generation);
+
+// Queue one of the loop's sounds on a mixer frame (as one voice, or two for a loop
+// stored at half level). Bars play in LOOPCACHE_CHOKE_GROUP_BAR and tails in
+// LOOPCACHE_CHOKE_GROUP_TAIL, so AudioMixer_chokeAt can cut either short.
+void LoopCache_play(patternLoop_t *pLoop, LoopSound sound, unsigned long long startFrame);
+
+// Queue a pass that starts on 'startFrame' and ends where the next one starts, on
+// 'endFrame', so consecutive passes join without a gap or an overlap. 'continues'
+// picks LOOP_SOUND_BAR over LOOP_SOUND_FIRST_BAR.
+void LoopCache_playBar(patternLoop_t *pLoop, bool continues,
+                       unsigned long long startFrame, unsigned long long endFrame);
+
+// Let the tail of the pass queued on 'barStartFrame' ring on from 'endFrame'.
+void LoopCache_playTail(patternLoop_t *pLoop, unsigned long long barStartFrame, unsigned long long endFrame);
+
+// Hand a loop back. It is freed once no voice plays from it any more.
+void LoopCache_release(patternLoop_t *pLoop);
+
+#endif
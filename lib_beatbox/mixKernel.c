@@ -0,0 +1,239 @@
+/*
+ * Mix Kernel Module
+ * * The inner loops of the audio mixer, vectorized for the CPUs we build on.
+ * * Mixing is split into two stages so the per-sample work stays branch-free:
+ * 1. Every voice is scaled by a Q15 fixed-point gain per side and added into an
+ *    interleaved stereo 32-bit accumulator (no clipping, no bounds checks per sample).
+ *    Pitched voices are first resampled into a scratch buffer with linear
+ *    interpolation (a gather on AVX2).
+ * 2. The accumulator is saturated down to 16 bits exactly once per buffer.
+ * * The instruction set is picked at compile time:
+ * - AVX2 when built with -mavx2 (or -march=native on a capable x86 host)
+ * - SSE2 on any x86-64 build
+ * - NEON on ARM (BeagleBone / BeagleY-AI)
+ * - A portable scalar loop everywhere else
+ */
+
+#include "mixKernel.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIX_USE_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define MIX_USE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIX_USE_NEON 1
+#endif
+
+// --- Private Helpers ---
+
+static inline int16_t saturate16(int32_t v)
+{
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return (int16_t)v;
+}
+
+// --- Public API ---
+
+const char* MixKernel_getName(void)
+{
+#if defined(MIX_USE_AVX2)
+    return "AVX2";
+#elif defined(MIX_USE_SSE2)
+    return "SSE2";
+#elif defined(MIX_USE_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+void MixKernel_clear(int32_t *pAcc, int count)
+{
+    memset(pAcc, 0, (size_t)count * sizeof(*pAcc));
+}
+
+void MixKernel_accumulateStereo(int32_t *pAcc, const int16_t *pSrc, int count,
+                                int32_t gainLeftQ15, int32_t gainRightQ15)
+{
+    int i = 0;
+
+#if defined(MIX_USE_AVX2)
+    // 8 samples (16 output slots) per step: scale by each side's gain, then
+    // interleave L/R. unpack works within 128-bit lanes, so fix the order with permute.
+    const __m256i gainL = _mm256_set1_epi32(gainLeftQ15);
+    const __m256i gainR = _mm256_set1_epi32(gainRightQ15);
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(pSrc + i)));
+        __m256i l = _mm256_srai_epi32(_mm256_mullo_epi32(s, gainL), 15);
+        __m256i r = _mm256_srai_epi32(_mm256_mullo_epi32(s, gainR), 15);
+        __m256i lo = _mm256_unpacklo_epi32(l, r); // L0 R0 L1 R1 | L4 R4 L5 R5
+        __m256i hi = _mm256_unpackhi_epi32(l, r); // L2 R2 L3 R3 | L6 R6 L7 R7
+        __m256i v0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+        __m256i v1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+        int32_t *pOut = pAcc + 2 * i;
+        _mm256_storeu_si256((__m256i*)pOut, _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)pOut), v0));
+        _mm256_storeu_si256((__m256i*)(pOut + 8), _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(pOut + 8)), v1));
+    }
+#elif defined(MIX_USE_SSE2)
+    // 8 samples per step. SSE2 has no 32-bit multiply, so duplicate each sample,
+    // widen it against 0 and use madd against (gainL, 0, gainR, 0): the result is
+    // already interleaved as s*gainL, s*gainR.
+    const __m128i gains = _mm_set_epi32(gainRightQ15 & 0xFFFF, gainLeftQ15 & 0xFFFF,
+                                        gainRightQ15 & 0xFFFF, gainLeftQ15 & 0xFFFF);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(pSrc + i));
+        __m128i d0 = _mm_unpacklo_epi16(s, s); // s0 s0 s1 s1 s2 s2 s3 s3
+        __m128i d1 = _mm_unpackhi_epi16(s, s); // s4 s4 ... s7 s7
+        __m128i v[4] = {
+            _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(d0, zero), gains), 15),
+            _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(d0, zero), gains), 15),
+            _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(d1, zero), gains), 15),
+            _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(d1, zero), gains), 15),
+        };
+        int32_t *pOut = pAcc + 2 * i;
+        for (int k = 0; k < 4; k++) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(pOut + 4 * k));
+            _mm_storeu_si128((__m128i*)(pOut + 4 * k), _mm_add_epi32(a, v[k]));
+        }
+    }
+#elif defined(MIX_USE_NEON)
+    // 4 samples per half-step: widening multiply by each gain, then a de-interleaving
+    // load / shift-right-accumulate / interleaving store of the L/R accumulator pairs.
+    const int16_t gainL = (int16_t)gainLeftQ15;
+    const int16_t gainR = (int16_t)gainRightQ15;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(pSrc + i);
+        int16x4_t halves[2] = { vget_low_s16(s), vget_high_s16(s) };
+        for (int k = 0; k < 2; k++) {
+            int32_t *pOut = pAcc + 2 * (i + 4 * k);
+            int32x4x2_t acc = vld2q_s32(pOut);
+            acc.val[0] = vsraq_n_s32(acc.val[0], vmull_n_s16(halves[k], gainL), 15);
+            acc.val[1] = vsraq_n_s32(acc.val[1], vmull_n_s16(halves[k], gainR), 15);
+            vst2q_s32(pOut, acc);
+        }
+    }
+#endif
+
+    // Scalar tail (and the whole buffer on targets without SIMD)
+    for (; i < count; i++) {
+        pAcc[2 * i]     += ((int32_t)pSrc[i] * gainLeftQ15) >> 15;
+        pAcc[2 * i + 1] += ((int32_t)pSrc[i] * gainRightQ15) >> 15;
+    }
+}
+
+int MixKernel_interpolate(int16_t *pOut, int maxOut, const int16_t *pSrc, int srcCount,
+                          uint32_t startQ16, uint32_t stepQ16)
+{
+    // Outputs whose right-hand neighbour is still inside the source need no bounds check
+    int safe = 0;
+    if (srcCount >= 2 && stepQ16 > 0) {
+        uint64_t lastSafe = ((uint64_t)(srcCount - 1) << 16) - 1; // Position must stay below srcCount - 1
+        if (startQ16 <= lastSafe) {
+            uint64_t n = (lastSafe - startQ16) / stepQ16 + 1;
+            safe = (n < (uint64_t)maxOut) ? (int)n : maxOut;
+        }
+    }
+
+    int i = 0;
+    uint32_t pos = startQ16;
+
+#if defined(MIX_USE_AVX2)
+    // 8 outputs per step. One 32-bit gather at each sample's 16-bit index picks up
+    // the sample and its right neighbour together (little-endian: low half, high half).
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32((int32_t)stepQ16);
+    const __m256i fracMask = _mm256_set1_epi32(0xFFFF);
+    for (; i + 8 <= safe; i += 8) {
+        __m256i p = _mm256_add_epi32(_mm256_set1_epi32((int32_t)pos), _mm256_mullo_epi32(lane, step));
+        __m256i idx = _mm256_srli_epi32(p, 16);
+        __m256i frac = _mm256_srli_epi32(_mm256_and_si256(p, fracMask), 1); // Q15 keeps the product in range
+        __m256i pair = _mm256_i32gather_epi32((const int *)pSrc, idx, 2);
+        __m256i s0 = _mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16);
+        __m256i s1 = _mm256_srai_epi32(pair, 16);
+        __m256i v = _mm256_add_epi32(s0, _mm256_srai_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(s1, s0), frac), 15));
+        v = _mm256_packs_epi32(v, v); // Values are in range; this just narrows
+        v = _mm256_permute4x64_epi64(v, 0x08);
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm256_castsi256_si128(v));
+        pos += 8 * stepQ16;
+    }
+#endif
+
+    // Branch-free scalar loop for the rest of the safe range
+    for (; i < safe; i++) {
+        uint32_t idx = pos >> 16;
+        int32_t frac = (int32_t)((pos & 0xFFFF) >> 1);
+        int32_t s0 = pSrc[idx];
+        int32_t s1 = pSrc[idx + 1];
+        pOut[i] = (int16_t)(s0 + (((s1 - s0) * frac) >> 15));
+        pos += stepQ16;
+    }
+
+    // The last source sample interpolates towards silence
+    for (; i < maxOut; i++) {
+        uint32_t idx = pos >> 16;
+        if ((int)idx >= srcCount) break;
+        int32_t frac = (int32_t)((pos & 0xFFFF) >> 1);
+        int32_t s0 = pSrc[idx];
+        int32_t s1 = ((int)idx + 1 < srcCount) ? pSrc[idx + 1] : 0;
+        pOut[i] = (int16_t)(s0 + (((s1 - s0) * frac) >> 15));
+        pos += stepQ16;
+    }
+    return i;
+}
+
+void MixKernel_add(int32_t *pAcc, const int32_t *pSrc, int count)
+{
+    int i = 0;
+
+#if defined(MIX_USE_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(pAcc + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(pSrc + i));
+        _mm256_storeu_si256((__m256i*)(pAcc + i), _mm256_add_epi32(a, b));
+    }
+#elif defined(MIX_USE_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(pAcc + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(pSrc + i));
+        _mm_storeu_si128((__m128i*)(pAcc + i), _mm_add_epi32(a, b));
+    }
+#elif defined(MIX_USE_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_s32(pAcc + i, vaddq_s32(vld1q_s32(pAcc + i), vld1q_s32(pSrc + i)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        pAcc[i] += pSrc[i];
+    }
+}
+
+void MixKernel_saturate(int16_t *pOut, const int32_t *pAcc, int count)
+{
+    int i = 0;
+
+#if defined(MIX_USE_AVX2) || defined(MIX_USE_SSE2)
+    // packs_epi32 narrows with signed saturation, which is exactly our clip.
+    for (; i + 8 <= count; i += 8) {
+        __m128i a0 = _mm_loadu_si128((const __m128i*)(pAcc + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i*)(pAcc + i + 4));
+        _mm_storeu_si128((__m128i*)(pOut + i), _mm_packs_epi32(a0, a1));
+    }
+#elif defined(MIX_USE_NEON)
+    for (; i + 8 <= count; i += 8) {
+        int16x4_t lo = vqmovn_s32(vld1q_s32(pAcc + i));
+        int16x4_t hi = vqmovn_s32(vld1q_s32(pAcc + i + 4));
+        vst1q_s16(pOut + i, vcombine_s16(lo, hi));
+    }
+#endif
+
+    for (; i < count; i++) {
+        pOut[i] = saturate16(pAcc[i]);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef MIXKERNEL_H
+#define MIXKERNEL_H
+
+#include <stdint.h>
+
+// Unity gain in Q15 fixed point (0.99997). Gains are in the range 0 .. MIXKERNEL_UNITY_Q15.
+#define MIXKERNEL_UNITY_Q15 32767
+
+// Name of the instruction set selected at compile time ("AVX2", "SSE2", "NEON" or "scalar").
+const char* MixKernel_getName(void);
+
+// Clear a 32-bit mixing accumulator.
+void MixKernel_clear(int32_t *pAcc, int count);
+
+// Mix one mono voice into an interleaved stereo accumulator:
+// pAcc[2i] += (pSrc[i] * gainLeftQ15) >> 15, pAcc[2i+1] += (pSrc[i] * gainRightQ15) >> 15.
+// No clipping happens here; the 32-bit accumulator has headroom for thousands of voices.
+void MixKernel_accumulateStereo(int32_t *pAcc, const int16_t *pSrc, int count,
+                                int32_t gainLeftQ15, int32_t gainRightQ15);
+
+// Resample for pitch: pOut[i] is pSrc linearly interpolated at startQ16 + i * stepQ16
+// (Q16.16 positions), with silence past the end of the source. Writes at most maxOut
+// samples and stops once a position passes srcCount; returns the number written.
+// maxOut * stepQ16 must fit in 32 bits.
+int MixKernel_interpolate(int16_t *pOut, int maxOut, const int16_t *pSrc, int srcCount,
+                          uint32_t startQ16, uint32_t stepQ16);
+
+// Add one accumulator into another: pAcc[i] += pSrc[i] (reduces per-thread mixes).
+void MixKernel_add(int32_t *pAcc, const int32_t *pSrc, int count);
+
+// Saturate the accumulator down to 16-bit output samples in one pass.
+// 'count' is in samples (two per stereo frame).
+void MixKernel_saturate(int16_t *pOut, const int32_t *pAcc, int count);
+
+#endif
@@ -6,6 +6,7 @@
  */
 
 #include "mpc3208.h"
+#include "probe.h"
 #include <fcntl.h>
 #include <linux/spi/spidev.h>
 #include <stdint.h>
@@ -76,6 +77,7 @@ int mpc3208_read_channel(int ch)
     };
     
     // 4. Perform Transfer
+    PROBE_SCOPE("spi");
     if (ioctl(spi_fd, SPI_IOC_MESSAGE(1), &tr) < 1) {
         perror("MPC3208: SPI transfer failed");
         return -1;
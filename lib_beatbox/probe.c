@@ -0,0 +1,59 @@
+/*
+ * Timing Probes
+ * * Backs the PROBE_* macros (see probe.h): each probe is an interval type
+ * registered by name on first use, fed through the lock-free interval timer.
+ */
+
+#include "probe.h"
+
+#ifdef BEATBOX_PROBES
+
+#include <time.h>
+
+// --- Private Helpers ---
+
+static long long nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// --- Public API ---
+
+IntervalType Probe_register(atomic_int *pType, const char *name)
+{
+    // Racing threads register the same name and so get the same type
+    IntervalType type = Interval_register(name);
+    atomic_store_explicit(pType, (int)type, memory_order_relaxed);
+    return type;
+}
+
+void Probe_mark(IntervalType type)
+{
+    if ((int)type >= 0) {
+        Interval_mark(type);
+    }
+}
+
+void Probe_record(IntervalType type, double ms)
+{
+    if ((int)type >= 0) {
+        Interval_record(type, ms);
+    }
+}
+
+probeScope_t Probe_begin(IntervalType type)
+{
+    probeScope_t scope = { type, ((int)type >= 0) ? nowNs() : 0 };
+    return scope;
+}
+
+void Probe_end(probeScope_t *pScope)
+{
+    if ((int)pScope->type >= 0) {
+        Interval_record(pScope->type, (nowNs() - pScope->startNs) / 1000000.0);
+    }
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+// Timing probes: named interval types (see intervalTimer.h) declared right where
+// they are measured. Their stats appear in the status line and the UDP "timing"
+// command next to the built-in ones.
+//
+//   PROBE_MARK("name")        Interval probe: time between successive marks on a thread
+//   PROBE_SCOPE("name")       Duration probe: from here to the end of the enclosing block
+//   PROBE_RECORD("name", ms)  Record a value measured some other way (e.g. lateness)
+//
+// A probe registers itself the first time it is reached; from then on recording
+// is lock-free. Probes are built in when BEATBOX_PROBES is defined (the CMake
+// option of the same name, on by default); otherwise every macro compiles to nothing.
+
+#include "intervalTimer.h"
+
+#ifdef BEATBOX_PROBES
+
+#include <stdatomic.h>
+
+#define PROBE_UNRESOLVED (-2)
+
+// An open duration probe
+typedef struct {
+    IntervalType type;
+    long long startNs;
+} probeScope_t;
+
+// Register probe 'name' and cache its type in *pType. -1 if there is no room left.
+IntervalType Probe_register(atomic_int *pType, const char *name);
+
+static inline IntervalType Probe_resolve(atomic_int *pType, const char *name)
+{
+    int type = atomic_load_explicit(pType, memory_order_relaxed);
+    return (type != PROBE_UNRESOLVED) ? (IntervalType)type : Probe_register(pType, name);
+}
+
+void Probe_mark(IntervalType type);
+void Probe_record(IntervalType type, double ms);
+probeScope_t Probe_begin(IntervalType type);
+void Probe_end(probeScope_t *pScope);
+
+#define PROBE_CONCAT_(a, b) a##b
+#define PROBE_NAME_(prefix, line) PROBE_CONCAT_(prefix, line)
+
+#define PROBE_MARK(name) do { \
+        static atomic_int s_probeType = PROBE_UNRESOLVED; \
+        Probe_mark(Probe_resolve(&s_probeType, name)); \
+    } while (0)
+
+#define PROBE_RECORD(name, ms) do { \
+        static atomic_int s_probeType = PROBE_UNRESOLVED; \
+        Probe_record(Probe_resolve(&s_probeType, name), (ms)); \
+    } while (0)
+
+#define PROBE_SCOPE(name) \
+    static atomic_int PROBE_NAME_(s_probeType_, __LINE__) = PROBE_UNRESOLVED; \
+    probeScope_t PROBE_NAME_(probeScope_, __LINE__) __attribute__((cleanup(Probe_end))) = \
+        Probe_begin(Probe_resolve(&PROBE_NAME_(s_probeType_, __LINE__), name))
+
+#else
+
+#define PROBE_MARK(name) ((void)0)
+#define PROBE_RECORD(name, ms) ((void)sizeof(ms))
+#define PROBE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Render Pool Module
+ * * A small fork-join pool for splitting one audio period's work across cores.
+ * The playback thread starts a pass, does worker 0's share itself, and waits for
+ * the helpers to finish before it touches their results.
+ * * Design:
+ * - One semaphore per helper starts it; one shared semaphore counts completions.
+ *   Both are futex-based, so an idle pool costs nothing and a pass costs one
+ *   wake-up per helper.
+ * - Helpers get the render role of the real-time profile (same priority as the
+ *   audio thread), so they are not preempted by the control threads mid-period.
+ */
+
+#include "renderPool.h"
+#include "rtProfile.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+// --- Internal State ---
+
+typedef struct {
+    pthread_t threadId;
+    sem_t start;
+    int index;
+} poolWorker_t;
+
+static poolWorker_t s_workers[RENDERPOOL_MAX_WORKERS];
+static int s_numWorkers = 1;          // Including the calling thread
+static RenderPoolJob s_job = NULL;
+static sem_t s_done;
+
+// Parameters of the current pass (published before the start semaphores are posted)
+static void *s_pPassArg = NULL;
+static int s_passWorkers = 1;
+static atomic_bool s_stopping = false;
+
+// --- Private Helpers ---
+
+static void* workerThread(void *arg)
+{
+    poolWorker_t *pWorker = arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_RENDER, "render");
+
+    for (;;) {
+        while (sem_wait(&pWorker->start) != 0) {
+            // Interrupted by a signal: keep waiting
+        }
+        if (atomic_load(&s_stopping)) {
+            break;
+        }
+        s_job(pWorker->index, s_passWorkers, s_pPassArg);
+        sem_post(&s_done);
+    }
+    return NULL;
+}
+
+// --- Public API ---
+
+bool RenderPool_init(int numWorkers, RenderPoolJob job)
+{
+    if (numWorkers < 1) numWorkers = 1;
+    if (numWorkers > RENDERPOOL_MAX_WORKERS) numWorkers = RENDERPOOL_MAX_WORKERS;
+
+    s_job = job;
+    s_numWorkers = 1;
+    atomic_store(&s_stopping, false);
+    sem_init(&s_done, 0, 0);
+
+    for (int i = 1; i < numWorkers; i++) {
+        poolWorker_t *pWorker = &s_workers[i];
+        pWorker->index = i;
+        sem_init(&pWorker->start, 0, 0);
+        if (pthread_create(&pWorker->threadId, NULL, workerThread, pWorker) != 0) {
+            printf("RenderPool: Unable to start render thread %d; using %d.\n", i, s_numWorkers);
+            sem_destroy(&pWorker->start);
+            return false;
+        }
+        s_numWorkers++;
+    }
+    return true;
+}
+
+void RenderPool_cleanup(void)
+{
+    atomic_store(&s_stopping, true);
+    for (int i = 1; i < s_numWorkers; i++) {
+        sem_post(&s_workers[i].start);
+        pthread_join(s_workers[i].threadId, NULL);
+        sem_destroy(&s_workers[i].start);
+    }
+    sem_destroy(&s_done);
+    s_numWorkers = 1;
+}
+
+int RenderPool_getNumWorkers(void)
+{
+    return s_numWorkers;
+}
+
+void RenderPool_run(int numWorkers, void *pArg)
+{
+    if (numWorkers > s_numWorkers) numWorkers = s_numWorkers;
+    if (numWorkers < 1) numWorkers = 1;
+
+    // sem_post/sem_wait order the pass parameters and the workers' results
+    s_pPassArg = pArg;
+    s_passWorkers = numWorkers;
+    for (int i = 1; i < numWorkers; i++) {
+        sem_post(&s_workers[i].start);
+    }
+
+    s_job(0, numWorkers, pArg);
+
+    for (int i = 1; i < numWorkers; i++) {
+        while (sem_wait(&s_done) != 0) {
+            // Interrupted by a signal: keep waiting
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef RENDERPOOL_H
+#define RENDERPOOL_H
+
+#include <stdbool.h>
+
+// Most threads (including the caller) one render pass can be split across.
+#define RENDERPOOL_MAX_WORKERS 8
+
+// Work done by each worker in a pass. 'worker' is 0 .. numWorkers-1; the thread
+// calling RenderPool_run() is always worker 0.
+typedef void (*RenderPoolJob)(int worker, int numWorkers, void *pArg);
+
+// Start numWorkers - 1 helper threads that run 'job' whenever a pass begins.
+// numWorkers of 1 starts no threads (passes run inline). Returns false if the
+// helper threads could not be started (the pool then runs inline).
+bool RenderPool_init(int numWorkers, RenderPoolJob job);
+void RenderPool_cleanup(void);
+
+int RenderPool_getNumWorkers(void);
+
+// Run one pass: every worker calls job(worker, numWorkers, pArg) once, and this
+// returns when all of them are done. Call from one thread only (the playback thread).
+// 'numWorkers' may be lower than the pool size for light passes (minimum 1).
+void RenderPool_run(int numWorkers, void *pArg);
+
+#endif
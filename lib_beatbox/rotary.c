@@ -3,12 +3,14 @@
  * * Handles the rotary encoder input using libgpiod.
  * This module runs a thread that waits for GPIO edge events (interrupts).
  * * Functionality:
- * 1. Push Button (SW): Cycles through Beat Modes (None -> Rock -> Custom).
+ * 1. Push Button (SW): Cycles through Beat Modes (None -> Rock -> Custom -> loaded patterns).
  * 2. Rotation (DT/CLK): Increases or decreases the BPM (Tempo).
  */
 
 #include "rotary.h"
 #include "beatGenerator.h"
+#include "rtProfile.h"
+#include "logger.h"
 #include <gpiod.h>
 #include <pthread.h>
 #include <stdio.h>
@@ -38,6 +40,7 @@ static atomic_int running = 0;
 static void* rotaryLoop(void *arg)
 {
     (void)arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_INPUT, "rotary");
     
     // 1. Open the GPIO chip
     chip = gpiod_chip_open(GPIO_CHIP_DEVICE);
@@ -116,9 +119,9 @@ static void* rotaryLoop(void *arg)
                 // This logic detects a transition from High to Low (Press)
                 if (lastSw == 1 && currentSw == 0) {
                     BeatMode m = BeatGenerator_getMode();
-                    m = (m + 1) % 3; // Cycle 0 -> 1 -> 2 -> 0
+                    m = (m + 1) % BeatGenerator_getNumModes(); // Cycle 0 -> 1 -> ... -> 0
                     BeatGenerator_setMode(m);
-                    printf("Rotary: Mode cycled to %d\n", m);
+                    Log_write(LOG_LEVEL_INFO, "Rotary: Mode cycled to %d (%s)", m, BeatGenerator_getModeName(m));
                 }
                 lastSw = currentSw;
             } 
@@ -157,7 +160,7 @@ static void* rotaryLoop(void *arg)
             
             // Read back the clamped value for display
             int actualTempo = BeatGenerator_getTempo();
-            printf("Rotary: Tempo changed to %d\n", actualTempo);
+            Log_write(LOG_LEVEL_INFO, "Rotary: Tempo changed to %d", actualTempo);
         }
     }
 
@@ -0,0 +1,187 @@
+/*
+ * Real-Time Profile Module
+ * * Opt-in scheduling setup for the threads that must never miss a deadline.
+ * By default every thread runs SCHED_OTHER wherever the kernel puts it, so the
+ * audio thread competes with the web server and the printf-heavy status thread.
+ * * When enabled:
+ * - Each thread asks for a SCHED_FIFO priority by role (audio > sequencer > input > control).
+ * - With more than one CPU, the audio thread gets the last CPU to itself and the
+ *   other threads share the rest (render helpers may run anywhere).
+ * - Memory is locked with mlockall() so it cannot be paged out, and the buffers the
+ *   audio path touches (samples, playback buffers, thread stacks) are pre-faulted.
+ * * Anything the process lacks the privileges for (no CAP_SYS_NICE, RLIMIT_RTPRIO or
+ * RLIMIT_MEMLOCK too low) is reported and skipped; the app keeps running normally.
+ */
+
+#define _GNU_SOURCE
+#include "rtProfile.h"
+#include "trace.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+// --- Configuration Constants ---
+
+#define STACK_PREFAULT_BYTES (64 * 1024) // Stack each real-time thread may touch
+
+// SCHED_FIFO priority per role (0 = leave at SCHED_OTHER)
+static const int s_rolePriority[NUM_RT_ROLES] = {
+    [RT_ROLE_AUDIO]      = 80,
+    [RT_ROLE_RENDER]     = 80,
+    [RT_ROLE_SEQUENCER]  = 70,
+    [RT_ROLE_INPUT]      = 60,
+    [RT_ROLE_CONTROL]    = 40,
+    [RT_ROLE_BACKGROUND] = 0,
+};
+
+// --- Internal State ---
+
+static bool s_enabled = false;
+
+// --- Private Helpers ---
+
+// Touch the stack below us so later calls on it do not page-fault.
+static void __attribute__((noinline)) prefaultStack(void)
+{
+    volatile char stack[STACK_PREFAULT_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+// Audio on the last CPU, everyone else on the others. Returns a description of the result.
+static const char* applyAffinity(RtRole role, char *pBuf, size_t size)
+{
+    long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numCpus < 2) {
+        return "single CPU, not pinned";
+    }
+    if (role == RT_ROLE_RENDER) {
+        return "any CPU"; // Render helpers exist to use the other cores
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (role == RT_ROLE_AUDIO) {
+        CPU_SET(numCpus - 1, &set);
+        snprintf(pBuf, size, "CPU %ld", numCpus - 1);
+    } else {
+        for (long cpu = 0; cpu < numCpus - 1; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+        snprintf(pBuf, size, "CPUs 0-%ld", numCpus - 2);
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+        snprintf(pBuf, size, "affinity failed (%s)", strerror(err));
+    }
+    return pBuf;
+}
+
+// --- Public API ---
+
+void RtProfile_init(bool enable)
+{
+    s_enabled = enable;
+    if (!enable) {
+        return;
+    }
+
+    // Lock current and future pages. MCL_ONFAULT (where available) locks pages as
+    // they are first touched instead of populating every mapping up front, so the
+    // default 8 MiB thread stacks do not all become resident; the hot buffers are
+    // pre-faulted explicitly instead.
+    // MCL_FUTURE makes every later mapping (thread stacks, kit arenas) count against
+    // RLIMIT_MEMLOCK, and mappings over the limit then fail outright. Unless the
+    // limit can be lifted, only lock what is mapped now.
+    int flags = MCL_CURRENT;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_MEMLOCK, &limit) == 0) {
+        if (limit.rlim_cur != RLIM_INFINITY) {
+            struct rlimit unlimited = { RLIM_INFINITY, RLIM_INFINITY };
+            if (setrlimit(RLIMIT_MEMLOCK, &unlimited) == 0) {
+                limit = unlimited;
+            }
+        }
+        if (limit.rlim_cur == RLIM_INFINITY) {
+            flags |= MCL_FUTURE;
+        }
+    }
+
+    int rc;
+#ifdef MCL_ONFAULT
+    rc = mlockall(flags | MCL_ONFAULT);
+    if (rc != 0 && errno == EINVAL) {
+        rc = mlockall(flags); // Kernel older than 4.4
+    }
+#else
+    rc = mlockall(flags);
+#endif
+    if (rc != 0) {
+        Log_write(LOG_LEVEL_WARN, "RtProfile: mlockall failed (%s); memory may be paged out.", strerror(errno));
+    } else if (!(flags & MCL_FUTURE)) {
+        Log_write(LOG_LEVEL_INFO, "RtProfile: Memory locked (current pages only; RLIMIT_MEMLOCK is %lu KiB).",
+                  (unsigned long)(limit.rlim_cur / 1024));
+    } else {
+        Log_write(LOG_LEVEL_INFO, "RtProfile: Memory locked (current and future pages).");
+    }
+}
+
+bool RtProfile_isEnabled(void)
+{
+    return s_enabled;
+}
+
+void RtProfile_applyToCurrentThread(RtRole role, const char *threadName)
+{
+    Trace_setThreadName(threadName);
+    if (!s_enabled) {
+        return;
+    }
+
+    char schedText[64];
+    int priority = s_rolePriority[role];
+    if (priority > 0) {
+        struct sched_param param = { .sched_priority = priority };
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) {
+            snprintf(schedText, sizeof(schedText), "SCHED_FIFO %d", priority);
+        } else {
+            snprintf(schedText, sizeof(schedText), "SCHED_OTHER (FIFO %d refused: %s)", priority, strerror(err));
+        }
+        prefaultStack();
+    } else {
+        snprintf(schedText, sizeof(schedText), "SCHED_OTHER");
+    }
+
+    char affinityText[64];
+    Log_write(LOG_LEVEL_INFO, "RtProfile: %s thread: %s, %s.", threadName, schedText,
+              applyAffinity(role, affinityText, sizeof(affinityText)));
+}
+
+void RtProfile_prefault(void *pData, size_t bytes, bool writable)
+{
+    if (!s_enabled || !pData) {
+        return;
+    }
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    volatile char *p = pData;
+    for (size_t i = 0; i < bytes; i += (size_t)pageSize) {
+        if (writable) {
+            p[i] = p[i];
+        } else {
+            (void)p[i];
+        }
+    }
+    if (bytes > 0) {
+        (void)p[bytes - 1];
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef RTPROFILE_H
+#define RTPROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// What a thread does; decides its real-time priority and which CPU it runs on.
+typedef enum {
+    RT_ROLE_AUDIO,      // Mixer playback thread (highest priority, own CPU when available)
+    RT_ROLE_RENDER,     // Voice render helpers (same priority as audio, any CPU)
+    RT_ROLE_SEQUENCER,  // Beat generator
+    RT_ROLE_INPUT,      // Accelerometer/joystick poll, rotary encoder
+    RT_ROLE_CONTROL,    // UDP command listener
+    RT_ROLE_BACKGROUND, // Kit loader: stays SCHED_OTHER, kept off the audio CPU
+    NUM_RT_ROLES        // Total count (Keep at end)
+} RtRole;
+
+// Turn the real-time profile on or off. Call once from main before any module
+// starts a thread. When enabled, locks the process memory (mlockall) and prints
+// whether that worked. When disabled, every other call here does nothing.
+void RtProfile_init(bool enable);
+bool RtProfile_isEnabled(void);
+
+// Call first thing in a thread function: names the thread's event trace, applies
+// the role's SCHED_FIFO priority and CPU affinity, pre-faults its stack, and prints
+// what actually took effect.
+// Settings the process is not allowed to change are skipped, not fatal.
+void RtProfile_applyToCurrentThread(RtRole role, const char *threadName);
+
+// Touch every page of a buffer so the real-time thread never takes a page fault on it.
+// 'writable' buffers are written (in place), others only read.
+void RtProfile_prefault(void *pData, size_t bytes, bool writable);
+
+#endif
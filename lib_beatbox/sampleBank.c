@@ -0,0 +1,750 @@
+/*
+ * Sample Bank Module
+ * * Owns the drum kit. Every .wav file in the kit folder is loaded once into a
+ * single contiguous arena, and the rest of the program refers to sounds by a
+ * small integer ID (or a role alias such as "snare") instead of passing
+ * wavedata_t pointers around.
+ * * Layout:
+ * - IDs follow the sorted file names, so they are stable across runs.
+ * - Each sound starts on a cache-line boundary inside the arena and is zero-padded
+ *   to the next one, so the mixer's vector loads never straddle two sounds.
+ * * Bank cache:
+ * - After a kit is built from its WAV files (parsed and converted), the index and
+ *   arena are written to one binary file in the kit folder (SAMPLEBANK_CACHE_FILE).
+ * - Later starts only stat() the WAVs: if their names, sizes and modification times
+ *   (and the engine's sample rate / resampler) still match the cache, the cache is
+ *   memory-mapped and the sounds play straight out of it, with no parsing or copying.
+ * - A checksum over the index and arena catches a truncated or corrupted cache,
+ *   which is then rebuilt.
+ * * Kit swapping (RCU-style):
+ * - Each loaded kit is its own bank object. A new kit is built on a background
+ *   thread, then published with one pointer swap; the mixer resolves sound IDs
+ *   against the published kit once per buffer and never takes a lock.
+ * - Voices already playing from the old kit play out. The old bank is freed only
+ *   when the mixer reports it idle (not current, and no voice still uses it).
+ * - Control threads read bank names and IDs under a mutex, so once the pointer is
+ *   swapped no control thread can still be looking at the old bank.
+ * - Role aliases ("base", "snare", "hihat") are stored by sound name, so they
+ *   follow a new kit that uses the same names (or names its files after the role).
+ * - Choke groups are stored by sound name too, and resolved into a per-ID table
+ *   whenever the kit or a group changes, so playing a sound needs no lock.
+ */
+
+#include "sampleBank.h"
+#include "audioMixer.h"
+#include "rtProfile.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// --- Configuration Constants ---
+
+#define ARENA_ALIGNMENT 64 // Cache line
+#define PATH_BUFFER_SIZE 512                 // Kit folder
+#define FILE_PATH_SIZE (PATH_BUFFER_SIZE + 256) // Kit folder + file name
+
+#define CACHE_MAGIC "BBXBANK"
+#define CACHE_VERSION 1
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+#define RETIRE_POLL_MS 5 // How often a replaced kit is checked for being out of use
+
+// --- Cache File Layout ---
+// [header][index entry x numSounds][padding][arena], native byte order,
+// arena 64-byte aligned.
+
+typedef struct {
+    char magic[8];        // CACHE_MAGIC
+    uint32_t version;     // CACHE_VERSION
+    uint32_t numSounds;
+    uint32_t sampleRate;
+    uint32_t arenaOffset; // Header + index, rounded up to ARENA_ALIGNMENT
+    uint64_t arenaBytes;
+    uint64_t sourceHash;  // Identity of the source WAVs and conversion settings
+    uint64_t checksum;    // Over the index and the arena
+    uint8_t reserved[16];
+} bankFileHeader_t;
+
+typedef struct {
+    char name[SAMPLEBANK_NAME_LEN];
+    uint64_t offset;      // Byte offset of the sound inside the arena
+    uint32_t numSamples;
+    uint32_t reserved;
+} bankFileEntry_t;
+
+_Static_assert(sizeof(bankFileHeader_t) == 64, "bank header layout");
+_Static_assert(sizeof(bankFileEntry_t) % 8 == 0, "bank index layout");
+
+// --- Internal State ---
+
+// One loaded kit
+typedef struct {
+    audioKit_t kit; // The sounds as the mixer sees them (kit.pSounds = sounds)
+    wavedata_t sounds[SAMPLEBANK_MAX_SOUNDS];
+    char names[SAMPLEBANK_MAX_SOUNDS][SAMPLEBANK_NAME_LEN];
+    char dirPath[PATH_BUFFER_SIZE];
+
+    // The arena is either malloc'd (built from WAVs) or inside a read-only cache mapping
+    short *pArena;
+    size_t arenaBytes;
+    void *pMapping;
+    size_t mappingSize;
+} sampleBank_t;
+
+typedef struct {
+    char alias[SAMPLEBANK_NAME_LEN];
+    char target[SAMPLEBANK_NAME_LEN]; // Name of the sound the alias stands for
+} bankAlias_t;
+
+// Current kit and aliases: read by control threads under the mutex
+static pthread_mutex_t s_bankMutex = PTHREAD_MUTEX_INITIALIZER;
+static sampleBank_t *s_pBank = NULL;
+static atomic_uint s_generation = 0; // Bumped on every kit change
+
+static bankAlias_t s_aliases[SAMPLEBANK_MAX_ALIASES];
+static int s_numAliases = 0;
+
+typedef struct {
+    char name[SAMPLEBANK_NAME_LEN];
+    int group;
+} bankChoke_t;
+
+// Choke groups by sound name (under the mutex), and resolved per ID of the current kit
+static bankChoke_t s_chokes[SAMPLEBANK_MAX_CHOKES];
+static int s_numChokes = 0;
+static atomic_int s_chokeById[SAMPLEBANK_MAX_SOUNDS];
+
+// Background kit loader
+static pthread_t s_loaderThreadId;
+static bool s_loaderStarted = false;   // A loader thread exists and has not been joined
+static atomic_bool s_loaderBusy = false;
+static char s_loaderPath[PATH_BUFFER_SIZE];
+
+// --- Private Helpers ---
+
+static int isWaveFile(const struct dirent *entry)
+{
+    size_t len = strlen(entry->d_name);
+    return len > 4 && strcmp(entry->d_name + len - 4, ".wav") == 0;
+}
+
+// "100051__menegass__gui-drum-bd-hard.wav" -> "gui-drum-bd-hard"
+static void makeSoundName(const char *fileName, char *name, size_t size)
+{
+    const char *start = fileName;
+    for (const char *p = strstr(fileName, "__"); p; p = strstr(p + 2, "__")) {
+        start = p + 2;
+    }
+    size_t len = strlen(start);
+    if (len > 4 && strcmp(start + len - 4, ".wav") == 0) {
+        len -= 4;
+    }
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(name, start, len);
+    name[len] = '\0';
+}
+
+static size_t alignUp(size_t bytes)
+{
+    return (bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static long long nowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// FNV-1a, continued from 'hash'
+static uint64_t hashBytes(uint64_t hash, const void *pData, size_t size)
+{
+    const uint8_t *p = pData;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// FNV-1a over 64-bit words (sizes are multiples of 8): fast enough to check
+// the whole arena on every start.
+static uint64_t hashWords(uint64_t hash, const void *pData, size_t size)
+{
+    const uint8_t *p = pData;
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Identity of a kit as it would be built now: every file's name, size and
+// modification time, plus the settings that shape the converted samples.
+static uint64_t hashSources(const char *dirPath, struct dirent **entries, int numEntries)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint32_t settings[3] = { CACHE_VERSION, AUDIOMIXER_SAMPLE_RATE, (uint32_t)AudioMixer_getResampleQuality() };
+    hash = hashBytes(hash, settings, sizeof(settings));
+
+    for (int i = 0; i < numEntries; i++) {
+        char path[FILE_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", dirPath, entries[i]->d_name);
+        struct stat st;
+        int64_t stamp[3] = { -1, 0, 0 };
+        if (stat(path, &st) == 0) {
+            stamp[0] = (int64_t)st.st_size;
+            stamp[1] = (int64_t)st.st_mtim.tv_sec;
+            stamp[2] = (int64_t)st.st_mtim.tv_nsec;
+        }
+        hash = hashBytes(hash, entries[i]->d_name, strlen(entries[i]->d_name) + 1);
+        hash = hashBytes(hash, stamp, sizeof(stamp));
+    }
+    return hash;
+}
+
+static void getCachePath(const char *dirPath, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s", dirPath, SAMPLEBANK_CACHE_FILE);
+}
+
+// Map the cache file into 'pBank' if it matches 'sourceHash'.
+// Returns false if there is no usable cache.
+static bool loadCache(sampleBank_t *pBank, uint64_t sourceHash)
+{
+    char path[FILE_PATH_SIZE];
+    getCachePath(pBank->dirPath, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(bankFileHeader_t)) {
+        close(fd);
+        return false;
+    }
+
+    // MAP_POPULATE: fault the whole kit in now rather than on the audio thread
+    size_t fileSize = (size_t)st.st_size;
+    void *map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const bankFileHeader_t *pHeader = map;
+    const bankFileEntry_t *pIndex = (const bankFileEntry_t *)(pHeader + 1);
+    size_t indexBytes = (size_t)pHeader->numSounds * sizeof(bankFileEntry_t);
+
+    const char *pReason = NULL;
+    if (memcmp(pHeader->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || pHeader->version != CACHE_VERSION) {
+        pReason = "unknown format";
+    } else if (pHeader->sourceHash != sourceHash || pHeader->sampleRate != AUDIOMIXER_SAMPLE_RATE) {
+        pReason = "kit changed";
+    } else if (pHeader->numSounds == 0 || pHeader->numSounds > SAMPLEBANK_MAX_SOUNDS
+            || pHeader->arenaOffset % ARENA_ALIGNMENT != 0
+            || pHeader->arenaOffset < sizeof(*pHeader) + indexBytes
+            || pHeader->arenaOffset + pHeader->arenaBytes != fileSize) {
+        pReason = "bad size";
+    } else {
+        uint64_t sum = hashWords(FNV_OFFSET_BASIS, pIndex, indexBytes);
+        sum = hashWords(sum, (const uint8_t *)map + pHeader->arenaOffset, pHeader->arenaBytes);
+        if (sum != pHeader->checksum) {
+            pReason = "checksum mismatch";
+        }
+    }
+    for (uint32_t i = 0; !pReason && i < pHeader->numSounds; i++) {
+        if (pIndex[i].offset % ARENA_ALIGNMENT != 0 || pIndex[i].numSamples == 0
+                || pIndex[i].offset + (uint64_t)pIndex[i].numSamples * sizeof(short) > pHeader->arenaBytes) {
+            pReason = "bad index";
+        }
+    }
+    if (pReason) {
+        Log_write(LOG_LEVEL_INFO, "SampleBank: Rebuilding %s (%s).", path, pReason);
+        munmap(map, fileSize);
+        return false;
+    }
+
+    // Adopt the mapping: sounds point straight into it
+    const uint8_t *pArena = (const uint8_t *)map + pHeader->arenaOffset;
+    for (uint32_t i = 0; i < pHeader->numSounds; i++) {
+        pBank->sounds[i].numSamples = (int)pIndex[i].numSamples;
+        pBank->sounds[i].pData = (short *)(pArena + pIndex[i].offset);
+        pBank->sounds[i].pMapping = NULL; // Owned by the bank, not the sound
+        pBank->sounds[i].mappingSize = 0;
+        memcpy(pBank->names[i], pIndex[i].name, SAMPLEBANK_NAME_LEN);
+        pBank->names[i][SAMPLEBANK_NAME_LEN - 1] = '\0';
+    }
+    pBank->pMapping = map;
+    pBank->mappingSize = fileSize;
+    pBank->pArena = (short *)pArena;
+    pBank->arenaBytes = pHeader->arenaBytes;
+    pBank->kit.numSounds = (int)pHeader->numSounds;
+    return true;
+}
+
+// Write a bank to its cache file. A failure (e.g. a read-only install folder)
+// only costs startup time, so it is reported and otherwise ignored.
+static void writeCache(const sampleBank_t *pBank, uint64_t sourceHash)
+{
+    char path[FILE_PATH_SIZE];
+    char tmpPath[FILE_PATH_SIZE + 8];
+    getCachePath(pBank->dirPath, path, sizeof(path));
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    int numSounds = pBank->kit.numSounds;
+    bankFileEntry_t index[SAMPLEBANK_MAX_SOUNDS];
+    memset(index, 0, sizeof(index));
+    for (int i = 0; i < numSounds; i++) {
+        memcpy(index[i].name, pBank->names[i], SAMPLEBANK_NAME_LEN);
+        index[i].offset = (uint64_t)((const char *)pBank->sounds[i].pData - (const char *)pBank->pArena);
+        index[i].numSamples = (uint32_t)pBank->sounds[i].numSamples;
+    }
+    size_t indexBytes = (size_t)numSounds * sizeof(bankFileEntry_t);
+
+    bankFileHeader_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.numSounds = (uint32_t)numSounds;
+    header.sampleRate = AUDIOMIXER_SAMPLE_RATE;
+    header.arenaOffset = (uint32_t)alignUp(sizeof(header) + indexBytes);
+    header.arenaBytes = pBank->arenaBytes;
+    header.sourceHash = sourceHash;
+    header.checksum = hashWords(hashWords(FNV_OFFSET_BASIS, index, indexBytes), pBank->pArena, pBank->arenaBytes);
+
+    static const uint8_t padding[ARENA_ALIGNMENT] = { 0 };
+    size_t padBytes = header.arenaOffset - sizeof(header) - indexBytes;
+
+    // Write to a temporary file and rename, so a crash never leaves a half-written cache
+    FILE *file = fopen(tmpPath, "wb");
+    bool ok = file != NULL
+        && fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(index, 1, indexBytes, file) == indexBytes
+        && fwrite(padding, 1, padBytes, file) == padBytes
+        && fwrite(pBank->pArena, 1, pBank->arenaBytes, file) == pBank->arenaBytes;
+    if (file && fclose(file) != 0) {
+        ok = false;
+    }
+    if (ok && rename(tmpPath, path) == 0) {
+        Log_write(LOG_LEVEL_INFO, "SampleBank: Wrote bank cache %s.", path);
+    } else {
+        Log_write(LOG_LEVEL_WARN, "SampleBank: WARNING: Unable to write bank cache %s; the next start will reload the WAV files.", path);
+        unlink(tmpPath);
+    }
+}
+
+// Parse (and convert) every WAV file and pack the results into the bank's arena.
+// Returns false on failure.
+static bool loadWaveFiles(sampleBank_t *pBank, struct dirent **entries, int numEntries)
+{
+    // 1. Load every file into a temporary buffer, totalling the arena size
+    wavedata_t loaded[SAMPLEBANK_MAX_SOUNDS];
+    int count = 0;
+    size_t totalBytes = 0;
+
+    for (int i = 0; i < numEntries; i++) {
+        if (count >= SAMPLEBANK_MAX_SOUNDS) {
+            Log_write(LOG_LEVEL_WARN, "WARNING: Sample bank full (%d sounds); skipping %s.",
+                      SAMPLEBANK_MAX_SOUNDS, entries[i]->d_name);
+            continue;
+        }
+        char path[FILE_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", pBank->dirPath, entries[i]->d_name);
+        if (AudioMixer_readWaveFileIntoMemory(path, &loaded[count]) && loaded[count].numSamples > 0) {
+            makeSoundName(entries[i]->d_name, pBank->names[count], SAMPLEBANK_NAME_LEN);
+            totalBytes += alignUp((size_t)loaded[count].numSamples * sizeof(short));
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: No usable .wav files in %s.", pBank->dirPath);
+        return false;
+    }
+
+    // 2. One aligned allocation for the whole kit
+    void *pArena = NULL;
+    if (posix_memalign(&pArena, ARENA_ALIGNMENT, totalBytes) != 0) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to allocate %zu-byte sample arena.", totalBytes);
+        for (int i = 0; i < count; i++) AudioMixer_freeWaveFileData(&loaded[i]);
+        return false;
+    }
+    memset(pArena, 0, totalBytes);
+
+    // 3. Pack the sounds into the arena and drop the temporaries
+    size_t offset = 0;
+    for (int i = 0; i < count; i++) {
+        size_t bytes = (size_t)loaded[i].numSamples * sizeof(short);
+        short *pDest = (short *)((char *)pArena + offset);
+        memcpy(pDest, loaded[i].pData, bytes);
+
+        pBank->sounds[i].numSamples = loaded[i].numSamples;
+        pBank->sounds[i].pData = pDest;
+        pBank->sounds[i].pMapping = NULL;
+        pBank->sounds[i].mappingSize = 0;
+
+        offset += alignUp(bytes);
+        AudioMixer_freeWaveFileData(&loaded[i]);
+    }
+    pBank->pArena = pArena;
+    pBank->arenaBytes = totalBytes;
+    pBank->kit.numSounds = count;
+    return true;
+}
+
+static void freeBank(sampleBank_t *pBank)
+{
+    if (pBank->pMapping) {
+        munmap(pBank->pMapping, pBank->mappingSize);
+    } else {
+        free(pBank->pArena);
+    }
+    free(pBank);
+}
+
+// Build a bank from a kit folder (from its cache when allowed and current).
+// Returns NULL on failure. Does not touch the published bank.
+static sampleBank_t* loadBank(const char *dirPath, bool useCache)
+{
+    long long startNs = nowNs();
+
+    struct dirent **entries = NULL;
+    int numEntries = scandir(dirPath, &entries, isWaveFile, alphasort);
+    if (numEntries < 0) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to open sample folder %s.", dirPath);
+        return NULL;
+    }
+
+    sampleBank_t *pBank = calloc(1, sizeof(*pBank));
+    if (!pBank) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to allocate a sample bank.");
+        for (int i = 0; i < numEntries; i++) free(entries[i]);
+        free(entries);
+        return NULL;
+    }
+    snprintf(pBank->dirPath, sizeof(pBank->dirPath), "%s", dirPath);
+    pBank->kit.pSounds = pBank->sounds;
+    atomic_init(&pBank->kit.activeVoices, 0);
+
+    uint64_t sourceHash = hashSources(dirPath, entries, numEntries);
+    bool fromCache = useCache && loadCache(pBank, sourceHash);
+    bool ok = fromCache;
+    if (!fromCache) {
+        ok = loadWaveFiles(pBank, entries, numEntries);
+        if (ok) {
+            writeCache(pBank, sourceHash);
+        }
+    }
+
+    for (int i = 0; i < numEntries; i++) free(entries[i]);
+    free(entries);
+
+    if (!ok) {
+        free(pBank);
+        return NULL;
+    }
+    // Fault the samples in now rather than on the audio thread's first hit
+    RtProfile_prefault(pBank->pArena, pBank->arenaBytes, false);
+
+    Log_write(LOG_LEVEL_INFO, "SampleBank: Loaded %d sounds (%zu KiB) from %s%s in %.1f ms.",
+              pBank->kit.numSounds, pBank->arenaBytes / 1024, dirPath, fromCache ? " (cached bank)" : "",
+              (nowNs() - startNs) / 1e6);
+    return pBank;
+}
+
+// Rebuild the per-ID choke group table for the current kit. Call with the mutex held.
+static void resolveChokesLocked(void)
+{
+    int numSounds = s_pBank ? s_pBank->kit.numSounds : 0;
+    for (int id = 0; id < SAMPLEBANK_MAX_SOUNDS; id++) {
+        int group = 0;
+        for (int i = 0; i < s_numChokes && id < numSounds; i++) {
+            if (strcmp(s_chokes[i].name, s_pBank->names[id]) == 0) {
+                group = s_chokes[i].group;
+            }
+        }
+        atomic_store_explicit(&s_chokeById[id], group, memory_order_relaxed);
+    }
+}
+
+// Make 'pNew' the current kit (may be NULL) and free the previous one once the
+// mixer has let go of it. Only the retiring thread waits; the mixer never does.
+static void publishBank(sampleBank_t *pNew)
+{
+    pthread_mutex_lock(&s_bankMutex);
+    sampleBank_t *pOld = s_pBank;
+    s_pBank = pNew;
+    atomic_fetch_add(&s_generation, 1);
+    resolveChokesLocked();
+    pthread_mutex_unlock(&s_bankMutex);
+
+    AudioMixer_setKit(pNew ? &pNew->kit : NULL);
+
+    if (pOld) {
+        struct timespec pause = { 0, RETIRE_POLL_MS * 1000000L };
+        while (!AudioMixer_isKitIdle(&pOld->kit)) {
+            nanosleep(&pause, NULL);
+        }
+        freeBank(pOld);
+    }
+}
+
+// ID of the sound called 'name' in the current kit, or -1. Call with the mutex held.
+static int findSoundLocked(const char *name)
+{
+    if (!s_pBank) return -1;
+    for (int i = 0; i < s_pBank->kit.numSounds; i++) {
+        if (strcmp(s_pBank->names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void* loaderThread(void *arg)
+{
+    (void)arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_BACKGROUND, "kit loader");
+    sampleBank_t *pBank = loadBank(s_loaderPath, true);
+    if (pBank) {
+        publishBank(pBank);
+        Log_write(LOG_LEVEL_INFO, "SampleBank: Switched to kit %s; previous kit released.", s_loaderPath);
+    } else {
+        Log_write(LOG_LEVEL_WARN, "SampleBank: Kit %s not loaded; keeping the current kit.", s_loaderPath);
+    }
+    atomic_store(&s_loaderBusy, false);
+    return NULL;
+}
+
+// --- Public API ---
+
+int SampleBank_load(const char *dirPath)
+{
+    sampleBank_t *pBank = loadBank(dirPath, true);
+    if (!pBank) return -1;
+    publishBank(pBank);
+    return pBank->kit.numSounds;
+}
+
+int SampleBank_rebuildCache(const char *dirPath)
+{
+    sampleBank_t *pBank = loadBank(dirPath, false);
+    if (!pBank) return -1;
+    publishBank(pBank);
+    return pBank->kit.numSounds;
+}
+
+bool SampleBank_loadAsync(const char *dirPath)
+{
+    if (atomic_exchange(&s_loaderBusy, true)) {
+        return false; // A kit is already loading
+    }
+
+    // Reap the previous (finished) loader before starting the next one
+    if (s_loaderStarted) {
+        pthread_join(s_loaderThreadId, NULL);
+        s_loaderStarted = false;
+    }
+    snprintf(s_loaderPath, sizeof(s_loaderPath), "%s", dirPath);
+    if (pthread_create(&s_loaderThreadId, NULL, loaderThread, NULL) != 0) {
+        atomic_store(&s_loaderBusy, false);
+        return false;
+    }
+    s_loaderStarted = true;
+    return true;
+}
+
+bool SampleBank_isLoading(void)
+{
+    return atomic_load(&s_loaderBusy);
+}
+
+void SampleBank_free(void)
+{
+    if (s_loaderStarted) {
+        pthread_join(s_loaderThreadId, NULL);
+        s_loaderStarted = false;
+    }
+    publishBank(NULL);
+
+    pthread_mutex_lock(&s_bankMutex);
+    s_numAliases = 0;
+    s_numChokes = 0;
+    pthread_mutex_unlock(&s_bankMutex);
+}
+
+int SampleBank_getCount(void)
+{
+    pthread_mutex_lock(&s_bankMutex);
+    int count = s_pBank ? s_pBank->kit.numSounds : 0;
+    pthread_mutex_unlock(&s_bankMutex);
+    return count;
+}
+
+unsigned int SampleBank_getGeneration(void)
+{
+    return atomic_load(&s_generation);
+}
+
+audioKit_t* SampleBank_acquireKit(unsigned int *pGeneration)
+{
+    audioKit_t *pKit = NULL;
+    pthread_mutex_lock(&s_bankMutex);
+    if (s_pBank) {
+        pKit = &s_pBank->kit;
+        atomic_fetch_add(&pKit->activeVoices, 1);
+    }
+    *pGeneration = atomic_load(&s_generation);
+    pthread_mutex_unlock(&s_bankMutex);
+    return pKit;
+}
+
+void SampleBank_releaseKit(audioKit_t *pKit)
+{
+    if (pKit) {
+        atomic_fetch_sub_explicit(&pKit->activeVoices, 1, memory_order_release);
+    }
+}
+
+bool SampleBank_getName(int id, char *pName, size_t size)
+{
+    bool found = false;
+    pthread_mutex_lock(&s_bankMutex);
+    if (s_pBank && id >= 0 && id < s_pBank->kit.numSounds) {
+        snprintf(pName, size, "%s", s_pBank->names[id]);
+        found = true;
+    }
+    pthread_mutex_unlock(&s_bankMutex);
+    return found;
+}
+
+bool SampleBank_getKitPath(char *pPath, size_t size)
+{
+    bool found = false;
+    pthread_mutex_lock(&s_bankMutex);
+    if (s_pBank) {
+        snprintf(pPath, size, "%s", s_pBank->dirPath);
+        found = true;
+    }
+    pthread_mutex_unlock(&s_bankMutex);
+    return found;
+}
+
+int SampleBank_findByName(const char *name)
+{
+    int id = -1;
+    pthread_mutex_lock(&s_bankMutex);
+    {
+        // An alias names a sound; in a kit without that sound, fall back to a
+        // sound named after the role itself (e.g. snare.wav)
+        bool isAlias = false;
+        for (int i = 0; i < s_numAliases && !isAlias; i++) {
+            if (strcmp(s_aliases[i].alias, name) == 0) {
+                isAlias = true;
+                id = findSoundLocked(s_aliases[i].target);
+            }
+        }
+        if (id < 0) {
+            id = findSoundLocked(name);
+        }
+    }
+    pthread_mutex_unlock(&s_bankMutex);
+    return id;
+}
+
+bool SampleBank_setAlias(const char *alias, int id)
+{
+    bool ok = false;
+    pthread_mutex_lock(&s_bankMutex);
+    if (s_pBank && id >= 0 && id < s_pBank->kit.numSounds) {
+        // Re-pointing an alias updates its entry in place
+        int i = 0;
+        while (i < s_numAliases && strcmp(s_aliases[i].alias, alias) != 0) {
+            i++;
+        }
+        if (i < SAMPLEBANK_MAX_ALIASES) {
+            snprintf(s_aliases[i].alias, SAMPLEBANK_NAME_LEN, "%s", alias);
+            memcpy(s_aliases[i].target, s_pBank->names[id], SAMPLEBANK_NAME_LEN);
+            if (i == s_numAliases) {
+                s_numAliases++;
+            }
+            ok = true;
+        }
+    }
+    pthread_mutex_unlock(&s_bankMutex);
+    return ok;
+}
+
+bool SampleBank_setChokeGroup(const char *name, int group)
+{
+    bool ok = false;
+    pthread_mutex_lock(&s_bankMutex);
+    {
+        int i = 0;
+        while (i < s_numChokes && strcmp(s_chokes[i].name, name) != 0) {
+            i++;
+        }
+        if (i < SAMPLEBANK_MAX_CHOKES) {
+            snprintf(s_chokes[i].name, SAMPLEBANK_NAME_LEN, "%s", name);
+            s_chokes[i].group = (group > 0) ? group : 0;
+            if (i == s_numChokes) {
+                s_numChokes++;
+            }
+            resolveChokesLocked();
+            ok = true;
+        }
+    }
+    pthread_mutex_unlock(&s_bankMutex);
+    return ok;
+}
+
+int SampleBank_getChokeGroup(int id)
+{
+    if (id < 0 || id >= SAMPLEBANK_MAX_SOUNDS) {
+        return 0;
+    }
+    return atomic_load_explicit(&s_chokeById[id], memory_order_relaxed);
+}
+
+void SampleBank_play(int id)
+{
+    SampleBank_playAt(id, AUDIOMIXER_FRAME_NOW);
+}
+
+void SampleBank_playAt(int id, unsigned long long startFrame)
+{
+    SampleBank_playWith(id, startFrame, NULL);
+}
+
+void SampleBank_playWith(int id, unsigned long long startFrame, const audioVoiceParams_t *pParams)
+{
+    // Resolved against the current kit by the mixer, so it is safe across kit swaps
+    if (id < 0) {
+        return;
+    }
+    // The sound's own choke group applies unless the caller picked one
+    audioVoiceParams_t params = AUDIOMIXER_VOICE_DEFAULTS;
+    if (pParams) {
+        params = *pParams;
+    }
+    if (params.chokeGroup == 0) {
+        params.chokeGroup = SampleBank_getChokeGroup(id);
+    }
+    AudioMixer_queueKitSoundAt(id, startFrame, &params);
+}
@@ -0,0 +1,91 @@
+#ifndef SAMPLEBANK_H
+#define SAMPLEBANK_H
+
+#include "audioMixer.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SAMPLEBANK_MAX_SOUNDS 128
+#define SAMPLEBANK_NAME_LEN   48
+#define SAMPLEBANK_MAX_ALIASES 16
+#define SAMPLEBANK_MAX_CHOKES  16
+
+// Pre-converted binary copy of a kit, kept inside the kit folder
+#define SAMPLEBANK_CACHE_FILE "kit.bank"
+
+// Role aliases the built-in patterns and the accelerometer play
+#define SAMPLEBANK_ROLE_BASE  "base"
+#define SAMPLEBANK_ROLE_SNARE "snare"
+#define SAMPLEBANK_ROLE_HIHAT "hihat"
+
+// Load every .wav file in 'dirPath' (sorted by file name, so IDs are stable) into one
+// contiguous, cache-line aligned arena, and make it the current kit. Sounds are
+// converted to the engine format on the way in. Any previous kit is freed once the
+// mixer stops using it (this call waits for that).
+// If the folder's bank cache is up to date it is memory-mapped instead; otherwise the
+// cache is (re)written after loading the WAVs.
+// Returns the number of sounds loaded, or -1 on failure (the current kit is kept).
+int SampleBank_load(const char *dirPath);
+
+// Like SampleBank_load, but always rebuilds the cache from the WAV files.
+int SampleBank_rebuildCache(const char *dirPath);
+
+// Load a kit on a background thread and swap it in without interrupting playback.
+// Voices already playing from the old kit finish; its memory is released after.
+// Returns false if another kit is still loading.
+bool SampleBank_loadAsync(const char *dirPath);
+bool SampleBank_isLoading(void);
+
+// Release the current kit (and wait for a background load). Call after the mixer has stopped.
+void SampleBank_free(void);
+
+// Number of sounds in the current kit (valid IDs are 0 .. count-1).
+int SampleBank_getCount(void);
+
+// Incremented whenever the current kit changes. Modules that cache sound IDs
+// resolve them again when this changes.
+unsigned int SampleBank_getGeneration(void);
+
+// Pin the current kit so it is not freed while a background thread reads its
+// samples (it counts as a playing voice), and report its generation. Returns NULL
+// if no kit is loaded. Every non-NULL kit must be handed to SampleBank_releaseKit.
+audioKit_t* SampleBank_acquireKit(unsigned int *pGeneration);
+void SampleBank_releaseKit(audioKit_t *pKit);
+
+// Copy the short name of a sound (its file name without the numeric/author prefix
+// and ".wav", e.g. "gui-drum-bd-hard"). Returns false for an invalid ID.
+bool SampleBank_getName(int id, char *pName, size_t size);
+
+// Copy the folder of the current kit. Returns false if no kit is loaded.
+bool SampleBank_getKitPath(char *pPath, size_t size);
+
+// Look up a sound in the current kit by alias (see SampleBank_setAlias) or name.
+// Returns -1 if unknown.
+int SampleBank_findByName(const char *name);
+
+// Give a sound an extra role name such as "base", "snare" or "hihat" (setting an
+// alias again re-points it). The alias refers to the sound's name, so it carries
+// over to a new kit with the same sound (or, failing that, to a sound named after
+// the alias).
+// Returns false if the ID is invalid or the alias table is full.
+bool SampleBank_setAlias(const char *alias, int id);
+
+// Put the sound called 'name' in a choke group (0 removes it): starting any sound
+// of a group fades out the others, e.g. a closed hi-hat cuts an open one. Like an
+// alias, the group is kept by name and applies to every kit with that sound.
+// Returns false if the choke table is full.
+bool SampleBank_setChokeGroup(const char *name, int group);
+
+// Choke group of a sound of the current kit (0 = none). Lock-free.
+int SampleBank_getChokeGroup(int id);
+
+// Queue a sound of the current kit by ID. IDs are resolved by the mixer when it
+// starts the voice; IDs the kit does not have are ignored.
+void SampleBank_play(int id);
+void SampleBank_playAt(int id, unsigned long long startFrame);
+
+// Same, with per-voice gain, pan and pitch (NULL for the defaults). A choke group
+// of 0 in 'pParams' means the sound's own group (see SampleBank_setChokeGroup).
+void SampleBank_playWith(int id, unsigned long long startFrame, const audioVoiceParams_t *pParams);
+
+#endif
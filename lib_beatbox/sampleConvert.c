@@ -0,0 +1,202 @@
+/*
+ * Sample Convert Module
+ * * Brings any WAV file we can decode into the engine's canonical format
+ * (mono, 16-bit signed, AUDIOMIXER_SAMPLE_RATE) when a kit is loaded, so the
+ * real-time thread only ever sees one format and never pays for conversion.
+ * * Pipeline (all in double precision):
+ * 1. Decode 8/16/24/32-bit PCM or 32/64-bit float frames.
+ * 2. Downmix by averaging the channels.
+ * 3. Resample with the selected quality (linear, cubic, or windowed sinc).
+ *    The sinc filter's cutoff follows the lower of the two rates, so
+ *    downsampling (e.g. 48 kHz -> 44.1 kHz) does not alias.
+ * 4. Round and saturate to 16 bits.
+ */
+
+#include "sampleConvert.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// --- Configuration Constants ---
+
+#define SINC_HALF_TAPS 16 // Taps on each side of the output point (at unity cutoff)
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// --- Private Helpers ---
+
+static int32_t readLE24(const uint8_t *p)
+{
+    int32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+    return (v & 0x800000) ? v - 0x1000000 : v; // Sign-extend
+}
+
+static int32_t readLE32s(const uint8_t *p)
+{
+    return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+// Decode one sample (container of 'bytes' bytes) to the range [-1, 1).
+static double decodeSample(const uint8_t *p, int formatTag, int bytes)
+{
+    if (formatTag == WAVEFILE_FORMAT_FLOAT) {
+        if (bytes == 4) { float f; memcpy(&f, p, sizeof(f)); return f; }
+        double d; memcpy(&d, p, sizeof(d)); return d;
+    }
+    switch (bytes) {
+        case 1: return ((int)p[0] - 128) / 128.0;                // 8-bit is unsigned
+        case 2: return (int16_t)(p[0] | (p[1] << 8)) / 32768.0;
+        case 3: return readLE24(p) / 8388608.0;
+        default: return readLE32s(p) / 2147483648.0;              // Also 24-in-32 (left-justified)
+    }
+}
+
+// Decode every frame and average the channels into one mono signal.
+static double* decodeToMono(const waveFile_t *pWave)
+{
+    double *pMono = malloc((pWave->numFrames + 1) * sizeof(double));
+    if (!pMono) return NULL;
+
+    int bytes = pWave->blockAlign / pWave->channels; // Container size per sample
+    for (size_t i = 0; i < pWave->numFrames; i++) {
+        const uint8_t *frame = pWave->pData + i * (size_t)pWave->blockAlign;
+        double sum = 0;
+        for (int ch = 0; ch < pWave->channels; ch++) {
+            sum += decodeSample(frame + ch * bytes, pWave->formatTag, bytes);
+        }
+        pMono[i] = sum / pWave->channels;
+    }
+    return pMono;
+}
+
+// Sample with zero padding outside the signal
+static inline double at(const double *x, long n, long i)
+{
+    return (i >= 0 && i < n) ? x[i] : 0.0;
+}
+
+static double interpolateLinear(const double *x, long n, double t)
+{
+    long i = (long)floor(t);
+    double f = t - i;
+    return at(x, n, i) + f * (at(x, n, i + 1) - at(x, n, i));
+}
+
+static double interpolateCubic(const double *x, long n, double t)
+{
+    long i = (long)floor(t);
+    double f = t - i;
+    double y0 = at(x, n, i - 1), y1 = at(x, n, i), y2 = at(x, n, i + 1), y3 = at(x, n, i + 2);
+
+    // Catmull-Rom spline through y1..y2
+    double a = -0.5 * y0 + 1.5 * y1 - 1.5 * y2 + 0.5 * y3;
+    double b = y0 - 2.5 * y1 + 2.0 * y2 - 0.5 * y3;
+    double c = -0.5 * y0 + 0.5 * y2;
+    return ((a * f + b) * f + c) * f + y1;
+}
+
+// Blackman-windowed sinc, low-passed at 'cutoff' (fraction of the source Nyquist).
+static double interpolateSinc(const double *x, long n, double t, double cutoff, int halfWidth)
+{
+    long center = (long)floor(t);
+    double sum = 0;
+    for (long j = center - halfWidth + 1; j <= center + halfWidth; j++) {
+        double d = t - j;
+        if (fabs(d) >= halfWidth) continue;
+        double w = 0.42 + 0.5 * cos(M_PI * d / halfWidth) + 0.08 * cos(2.0 * M_PI * d / halfWidth);
+        double arg = M_PI * d * cutoff;
+        double sinc = (fabs(arg) < 1e-9) ? 1.0 : sin(arg) / arg;
+        sum += at(x, n, j) * cutoff * sinc * w;
+    }
+    return sum;
+}
+
+static short toInt16(double v)
+{
+    double s = floor(v * 32768.0 + 0.5);
+    if (s > 32767.0) return 32767;
+    if (s < -32768.0) return -32768;
+    return (short)s;
+}
+
+// --- Public API ---
+
+bool SampleConvert_parseQuality(const char *name, ResampleQuality *pQuality)
+{
+    if (strcmp(name, "linear") == 0) { *pQuality = RESAMPLE_LINEAR; return true; }
+    if (strcmp(name, "cubic") == 0)  { *pQuality = RESAMPLE_CUBIC;  return true; }
+    if (strcmp(name, "sinc") == 0)   { *pQuality = RESAMPLE_SINC;   return true; }
+    return false;
+}
+
+const char* SampleConvert_getQualityName(ResampleQuality quality)
+{
+    switch (quality) {
+        case RESAMPLE_LINEAR: return "linear";
+        case RESAMPLE_CUBIC:  return "cubic";
+        case RESAMPLE_SINC:   return "sinc";
+    }
+    return "?";
+}
+
+bool SampleConvert_isSupported(const waveFile_t *pWave)
+{
+    if (pWave->channels < 1 || pWave->blockAlign % pWave->channels != 0) {
+        return false;
+    }
+    int bytes = pWave->blockAlign / pWave->channels;
+    if (pWave->formatTag == WAVEFILE_FORMAT_PCM) {
+        return bytes >= 1 && bytes <= 4;
+    }
+    if (pWave->formatTag == WAVEFILE_FORMAT_FLOAT) {
+        return bytes == 4 || bytes == 8;
+    }
+    return false;
+}
+
+short* SampleConvert_toMono16(const waveFile_t *pWave, int dstRate, ResampleQuality quality,
+                              int *pNumSamples)
+{
+    if (!SampleConvert_isSupported(pWave) || pWave->numFrames == 0) {
+        return NULL;
+    }
+
+    double *pMono = decodeToMono(pWave);
+    if (!pMono) return NULL;
+
+    long srcCount = (long)pWave->numFrames;
+    double step = (double)pWave->sampleRate / dstRate; // Source frames per output frame
+    long dstCount = (long)floor((srcCount - 1) / step) + 1;
+
+    short *pOut = malloc((size_t)dstCount * sizeof(short));
+    if (!pOut) {
+        free(pMono);
+        return NULL;
+    }
+
+    // When downsampling, lower the sinc cutoff (and widen it to keep the same
+    // transition band) so content above the new Nyquist is filtered out.
+    double cutoff = (step > 1.0) ? 1.0 / step : 1.0;
+    int halfWidth = (int)ceil(SINC_HALF_TAPS / cutoff);
+
+    for (long i = 0; i < dstCount; i++) {
+        double t = i * step;
+        double v;
+        if (pWave->sampleRate == dstRate) {
+            v = pMono[i];
+        } else if (quality == RESAMPLE_LINEAR) {
+            v = interpolateLinear(pMono, srcCount, t);
+        } else if (quality == RESAMPLE_CUBIC) {
+            v = interpolateCubic(pMono, srcCount, t);
+        } else {
+            v = interpolateSinc(pMono, srcCount, t, cutoff, halfWidth);
+        }
+        pOut[i] = toInt16(v);
+    }
+
+    free(pMono);
+    *pNumSamples = (int)dstCount;
+    return pOut;
+}
@@ -0,0 +1,27 @@
+#ifndef SAMPLECONVERT_H
+#define SAMPLECONVERT_H
+
+#include "waveFile.h"
+#include <stdbool.h>
+
+// Resampler quality (all run at load time, never on the audio thread)
+typedef enum {
+    RESAMPLE_LINEAR = 0, // 2-point linear interpolation (fastest load)
+    RESAMPLE_CUBIC,      // 4-point Catmull-Rom
+    RESAMPLE_SINC        // 32-tap Blackman-windowed sinc (band-limited; default)
+} ResampleQuality;
+
+// Parse "linear", "cubic" or "sinc". Returns false if the name is not recognized.
+bool SampleConvert_parseQuality(const char *name, ResampleQuality *pQuality);
+const char* SampleConvert_getQualityName(ResampleQuality quality);
+
+// True if the file's sample format can be decoded: 8-bit unsigned, 16/24/32-bit
+// signed PCM, or 32/64-bit float, with any number of channels.
+bool SampleConvert_isSupported(const waveFile_t *pWave);
+
+// Decode, downmix to mono, resample to 'dstRate' and convert to 16-bit.
+// Returns a malloc'd buffer (caller frees) and sets *pNumSamples, or NULL on failure.
+short* SampleConvert_toMono16(const waveFile_t *pWave, int dstRate, ResampleQuality quality,
+                              int *pNumSamples);
+
+#endif
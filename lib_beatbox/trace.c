@@ -0,0 +1,270 @@
+/*
+ * Event Trace Module
+ * * Always-on flight recorder: every thread appends timestamped binary events to
+ * a ring of its own (no locks, no contention, no formatting). When something
+ * glitches, Trace_dump turns the rings into Chrome trace JSON so the threads'
+ * timelines can be lined up in a browser.
+ * * A ring has a single writer, its thread. Readers copy it while it keeps
+ * recording and then drop whatever the writer may have overwritten meanwhile.
+ * * When a thread exits its ring is retired: its events stay in dumps until a new
+ * thread takes the ring over, so short-lived threads (kit loaders) reuse rings
+ * rather than adding one each.
+ */
+
+#include "trace.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// --- Configuration Constants ---
+
+#define MAX_THREADS 32
+#define NAME_LEN    16
+#define RING_MASK   (TRACE_RING_EVENTS - 1)
+
+#if (TRACE_RING_EVENTS & RING_MASK) != 0
+#error "TRACE_RING_EVENTS must be a power of two"
+#endif
+
+// --- Internal Data Structures ---
+
+typedef struct {
+    long long ns;
+    int32_t argA;
+    int32_t argB;
+    int32_t event;
+} traceRecord_t;
+
+typedef struct {
+    traceRecord_t records[TRACE_RING_EVENTS];
+    atomic_ullong head;          // Events ever written (the next one goes to head & RING_MASK)
+    atomic_bool retired;         // Its thread has exited; a new thread may take it over
+    int tid;
+    char name[NAME_LEN];
+} traceRing_t;
+
+// How each event shows up in the trace
+typedef struct {
+    const char *name;
+    char phase;                  // Chrome trace phase: 'i' instant, 'B'/'E' begin/end
+    const char *argA;            // Argument names (NULL = not shown)
+    const char *argB;
+} traceEventInfo_t;
+
+// --- Internal State ---
+
+static const traceEventInfo_t s_events[NUM_TRACE_EVENTS] = {
+    [TRACE_TRIGGER_QUEUED] = { "trigger queued", 'i', "sound", "scheduled" },
+    [TRACE_VOICE_START]    = { "voice start",    'i', "sound", "voice" },
+    [TRACE_VOICE_END]      = { "voice end",      'i', "voice", NULL },
+    [TRACE_RENDER_BEGIN]   = { "render",         'B', NULL, NULL },
+    [TRACE_RENDER_END]     = { "render",         'E', "audible", "voices" },
+    [TRACE_PCM_WRITE]      = { "pcm write",      'i', "frames", "period" },
+    [TRACE_XRUN]           = { "xrun",           'i', "xruns", "failures" },
+    [TRACE_UDP_COMMAND]    = { "udp command",    'i', "length", NULL },
+    [TRACE_BEAT_STEP]      = { "beat step",      'i', "step", "framesAhead" },
+};
+
+// Every ring ever created. Rings are never freed (a dump may read the ring of a
+// thread that has finished), only handed to a new thread once retired.
+static traceRing_t *_Atomic s_rings[MAX_THREADS];
+static atomic_int s_numRings = 0;
+static pthread_mutex_t s_ringMutex = PTHREAD_MUTEX_INITIALIZER;  // Ring creation and reuse
+static pthread_mutex_t s_dumpMutex = PTHREAD_MUTEX_INITIALIZER;  // One dump at a time (or ring reuse)
+
+static _Thread_local traceRing_t *t_pRing = NULL;
+
+// Holds each thread's ring so it is retired when the thread exits
+static pthread_key_t s_ringKey;
+static pthread_once_t s_ringKeyOnce = PTHREAD_ONCE_INIT;
+
+// Set once the ring table is full, so the warning is printed once
+static atomic_bool s_outOfRings = false;
+
+// --- Private Helpers ---
+
+static long long nowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+// Thread exit: leave the ring's events for dumps until another thread needs it
+static void retireRing(void *pValue)
+{
+    traceRing_t *pRing = pValue;
+    t_pRing = NULL;
+    atomic_store(&pRing->retired, true);
+}
+
+static void createRingKey(void)
+{
+    pthread_key_create(&s_ringKey, retireRing);
+}
+
+// Give the calling thread a ring: a retired one if there is one, else a new one.
+// NULL if MAX_THREADS rings are in use.
+static traceRing_t* newRing(const char *name)
+{
+    pthread_once(&s_ringKeyOnce, createRingKey);
+
+    traceRing_t *pRing = NULL;
+    pthread_mutex_lock(&s_ringMutex);
+    int numRings = atomic_load(&s_numRings);
+    for (int r = 0; r < numRings && !pRing; r++) {
+        traceRing_t *pOld = atomic_load(&s_rings[r]);
+        if (atomic_load(&pOld->retired)) {
+            pRing = pOld;
+        }
+    }
+    if (pRing) {
+        // Not while a dump is copying the old thread's events
+        pthread_mutex_lock(&s_dumpMutex);
+        atomic_store(&pRing->head, 0);
+        atomic_store(&pRing->retired, false);
+        pRing->tid = (int)syscall(SYS_gettid);
+        snprintf(pRing->name, NAME_LEN, "%s", name);
+        pthread_mutex_unlock(&s_dumpMutex);
+    } else if (numRings < MAX_THREADS) {
+        pRing = calloc(1, sizeof(*pRing));
+        if (pRing) {
+            pRing->tid = (int)syscall(SYS_gettid);
+            snprintf(pRing->name, NAME_LEN, "%s", name);
+            atomic_store(&s_rings[numRings], pRing);
+            atomic_store(&s_numRings, numRings + 1);
+        }
+    }
+    pthread_mutex_unlock(&s_ringMutex);
+
+    if (pRing) {
+        pthread_setspecific(s_ringKey, pRing);
+    }
+
+    if (!pRing && !atomic_exchange(&s_outOfRings, true)) {
+        Log_write(LOG_LEVEL_WARN, "Trace: WARNING: More than %d threads at once; the rest are not traced.", MAX_THREADS);
+    }
+    return pRing;
+}
+
+// Copy the events of 'pRing' that are still intact into 'pCopy' (oldest first).
+// Returns how many there are.
+static int copyRing(traceRing_t *pRing, traceRecord_t *pCopy)
+{
+    unsigned long long head = atomic_load_explicit(&pRing->head, memory_order_acquire);
+    unsigned long long first = (head > TRACE_RING_EVENTS) ? head - TRACE_RING_EVENTS : 0;
+    for (unsigned long long i = first; i < head; i++) {
+        pCopy[i - first] = pRing->records[i & RING_MASK];
+    }
+
+    // The writer may have lapped the start of what we copied: skip those slots.
+    // (The event being written now overwrites index 'headAfter - TRACE_RING_EVENTS'.)
+    atomic_thread_fence(memory_order_acquire);
+    unsigned long long headAfter = atomic_load_explicit(&pRing->head, memory_order_relaxed);
+    unsigned long long valid = (headAfter >= TRACE_RING_EVENTS) ? headAfter - TRACE_RING_EVENTS + 1 : 0;
+    if (valid <= first) {
+        return (int)(head - first);
+    }
+    if (valid >= head) {
+        return 0;
+    }
+    memmove(pCopy, pCopy + (valid - first), (size_t)(head - valid) * sizeof(*pCopy));
+    return (int)(head - valid);
+}
+
+static void writeArgs(FILE *pFile, const traceEventInfo_t *pInfo, const traceRecord_t *pRecord)
+{
+    if (!pInfo->argA) {
+        return;
+    }
+    fprintf(pFile, ",\"args\":{\"%s\":%d", pInfo->argA, (int)pRecord->argA);
+    if (pInfo->argB) {
+        fprintf(pFile, ",\"%s\":%d", pInfo->argB, (int)pRecord->argB);
+    }
+    fprintf(pFile, "}");
+}
+
+// --- Public API ---
+
+void Trace_setThreadName(const char *name)
+{
+    if (!t_pRing) {
+        t_pRing = newRing(name);
+    } else {
+        snprintf(t_pRing->name, NAME_LEN, "%s", name);
+    }
+}
+
+void Trace_event(TraceEvent event, int argA, int argB)
+{
+    traceRing_t *pRing = t_pRing;
+    if (!pRing) {
+        pRing = t_pRing = newRing("thread");
+        if (!pRing) return;
+    }
+
+    unsigned long long head = atomic_load_explicit(&pRing->head, memory_order_relaxed);
+    traceRecord_t *pRecord = &pRing->records[head & RING_MASK];
+    pRecord->ns = nowNs();
+    pRecord->argA = argA;
+    pRecord->argB = argB;
+    pRecord->event = event;
+    atomic_store_explicit(&pRing->head, head + 1, memory_order_release);
+}
+
+int Trace_dump(const char *path)
+{
+    if (!path) {
+        path = TRACE_DEFAULT_PATH;
+    }
+    FILE *pFile = fopen(path, "w");
+    if (!pFile) {
+        perror("Trace: Failed to open dump file");
+        return -1;
+    }
+
+    pthread_mutex_lock(&s_dumpMutex);
+    static traceRecord_t copy[TRACE_RING_EVENTS]; // Dumps are serialized; too big for the stack
+    int pid = (int)getpid();
+    int total = 0;
+
+    fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    int numRings = atomic_load(&s_numRings);
+    for (int r = 0; r < numRings; r++) {
+        traceRing_t *pRing = atomic_load(&s_rings[r]);
+        fprintf(pFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                (r > 0) ? "," : "", pid, pRing->tid, pRing->name);
+
+        int count = copyRing(pRing, copy);
+        for (int i = 0; i < count; i++) {
+            const traceRecord_t *pRecord = &copy[i];
+            if (pRecord->event < 0 || pRecord->event >= NUM_TRACE_EVENTS) {
+                continue;
+            }
+            const traceEventInfo_t *pInfo = &s_events[pRecord->event];
+            fprintf(pFile, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d",
+                    pInfo->name, pInfo->phase, pRecord->ns / 1000, pRecord->ns % 1000, pid, pRing->tid);
+            if (pInfo->phase == 'i') {
+                fprintf(pFile, ",\"s\":\"t\"");
+            }
+            writeArgs(pFile, pInfo, pRecord);
+            fprintf(pFile, "}");
+            total++;
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+    pthread_mutex_unlock(&s_dumpMutex);
+
+    if (fclose(pFile) != 0) {
+        perror("Trace: Failed to write dump file");
+        return -1;
+    }
+    return total;
+}
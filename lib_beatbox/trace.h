@@ -0,0 +1,40 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+// Where the UDP "trace" command and SIGUSR1 write a dump
+#define TRACE_DEFAULT_PATH "/tmp/beatbox-trace.json"
+
+// Events each thread keeps (the oldest are overwritten); a power of two
+#define TRACE_RING_EVENTS 4096
+
+// What happened. Each event carries two integer arguments, listed here.
+typedef enum {
+    TRACE_TRIGGER_QUEUED, // Sound ID (-1 if not a kit sound), 1 if scheduled ahead
+    TRACE_VOICE_START,    // Sound ID (-1 if not a kit sound), voice serial
+    TRACE_VOICE_END,      // Voice serial
+    TRACE_RENDER_BEGIN,   // (none)
+    TRACE_RENDER_END,     // 1 if anything was mixed, voices still active
+    TRACE_PCM_WRITE,      // Frames written (or negative error), frames per period
+    TRACE_XRUN,           // Under-runs so far, recovery failures so far
+    TRACE_UDP_COMMAND,    // Command length
+    TRACE_BEAT_STEP,      // Pattern step, frames ahead of the mixer when queued
+    NUM_TRACE_EVENTS      // Total count (Keep at end)
+} TraceEvent;
+
+// Name the calling thread's trace (and set up its ring now rather than on its
+// first event). RtProfile_applyToCurrentThread does this for every module thread.
+// When the thread exits its ring is kept for dumps until a new thread reuses it.
+void Trace_setThreadName(const char *name);
+
+// Record an event on the calling thread's ring: a CLOCK_MONOTONIC timestamp and
+// two stores. Lock-free and never blocks; costs tens of nanoseconds.
+void Trace_event(TraceEvent event, int argA, int argB);
+
+// Write every thread's ring to 'path' (NULL = TRACE_DEFAULT_PATH) as Chrome trace
+// JSON, for chrome://tracing or ui.perfetto.dev. Recording carries on meanwhile.
+// Returns the number of events written, or -1 if the file could not be written.
+int Trace_dump(const char *path);
+
+#endif
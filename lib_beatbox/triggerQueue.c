@@ -0,0 +1,109 @@
+/*
+ * Trigger Queue Module
+ * * A bounded, lock-free multi-producer / single-consumer ring buffer that carries
+ * "start this sound" requests from the control threads (beat generator, accelerometer,
+ * UDP) to the audio playback thread.
+ * * Design:
+ * - Each cell carries a sequence number (Vyukov-style bounded queue). A producer claims
+ *   a cell with one compare-and-swap on the enqueue position, fills it, then publishes
+ *   it by bumping the cell's sequence.
+ * - The single consumer never writes the enqueue position, so it never spins or blocks:
+ *   it simply stops draining when the next cell is not yet published.
+ * - When the ring is full the trigger is dropped and counted, so producers never wait.
+ */
+
+#include "triggerQueue.h"
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Configuration Constants ---
+
+#define QUEUE_MASK (TRIGGER_QUEUE_SIZE - 1)
+#define CACHE_LINE_SIZE 64
+
+#if (TRIGGER_QUEUE_SIZE & QUEUE_MASK) != 0
+#error "TRIGGER_QUEUE_SIZE must be a power of 2"
+#endif
+
+// --- Internal State ---
+
+typedef struct {
+    atomic_size_t sequence; // == position when free, position + 1 when published
+    audioTrigger_t trigger;
+} triggerCell_t;
+
+static triggerCell_t s_cells[TRIGGER_QUEUE_SIZE];
+
+// Producer and consumer positions live on separate cache lines so the playback
+// thread draining the ring does not bounce the line the producers CAS on.
+static atomic_size_t s_enqueuePos __attribute__((aligned(CACHE_LINE_SIZE)));
+static size_t s_dequeuePos __attribute__((aligned(CACHE_LINE_SIZE))); // Consumer-owned
+static atomic_ulong s_droppedCount __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// --- Public API ---
+
+void TriggerQueue_init(void)
+{
+    for (size_t i = 0; i < TRIGGER_QUEUE_SIZE; i++) {
+        atomic_store_explicit(&s_cells[i].sequence, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&s_enqueuePos, 0, memory_order_relaxed);
+    s_dequeuePos = 0;
+    atomic_store_explicit(&s_droppedCount, 0, memory_order_release);
+}
+
+bool TriggerQueue_push(const audioTrigger_t *pTrigger)
+{
+    triggerCell_t *cell;
+    size_t pos = atomic_load_explicit(&s_enqueuePos, memory_order_relaxed);
+
+    for (;;) {
+        cell = &s_cells[pos & QUEUE_MASK];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            // Cell is free for this position: try to claim it.
+            // On failure 'pos' is reloaded with the current value and we retry.
+            if (atomic_compare_exchange_weak_explicit(&s_enqueuePos, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Consumer has not freed this cell yet: the ring is full.
+            atomic_fetch_add_explicit(&s_droppedCount, 1, memory_order_relaxed);
+            return false;
+        } else {
+            // Another producer claimed this position first; catch up.
+            pos = atomic_load_explicit(&s_enqueuePos, memory_order_relaxed);
+        }
+    }
+
+    cell->trigger = *pTrigger;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+bool TriggerQueue_pop(audioTrigger_t *pTrigger)
+{
+    triggerCell_t *cell = &s_cells[s_dequeuePos & QUEUE_MASK];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+
+    // Not yet published (either empty, or a producer is mid-write)
+    if ((intptr_t)seq - (intptr_t)(s_dequeuePos + 1) < 0) {
+        return false;
+    }
+
+    *pTrigger = cell->trigger;
+
+    // Hand the cell back to producers for the next lap around the ring
+    atomic_store_explicit(&cell->sequence, s_dequeuePos + TRIGGER_QUEUE_SIZE, memory_order_release);
+    s_dequeuePos++;
+    return true;
+}
+
+unsigned long TriggerQueue_getDroppedCount(void)
+{
+    return atomic_load_explicit(&s_droppedCount, memory_order_relaxed);
+}
@@ -0,0 +1,39 @@
+#ifndef TRIGGERQUEUE_H
+#define TRIGGERQUEUE_H
+
+#include "audioMixer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of pending triggers the ring can hold (must be a power of 2).
+// Triggers pushed while the ring is full are dropped and counted.
+#define TRIGGER_QUEUE_SIZE 256
+
+// A single request to start a voice, handed from a control thread to the mixer.
+typedef struct {
+    wavedata_t *pSound;            // Sound to play, or NULL to play 'soundId' from the current kit
+    int soundId;                   // -1 with no pSound: only choke 'chokeGroup'
+    audioKit_t *pKit;              // Kit pinned by the producer for pSound (or NULL); the voice takes the reference
+    unsigned long long startFrame; // Mixer frame to start on (AUDIOMIXER_FRAME_NOW = next buffer)
+    long long queuedNs;            // CLOCK_MONOTONIC time it was queued (latency stats)
+    int16_t gainLeftQ15;           // Voice gain with pan applied, per side
+    int16_t gainRightQ15;
+    uint32_t stepQ16;              // Pitch: source samples per output frame (Q16.16)
+    int chokeGroup;                // 0 = none
+} audioTrigger_t;
+
+// Reset the ring to empty. Must be called before any producer or the consumer runs.
+void TriggerQueue_init(void);
+
+// Producer side (any thread, lock-free).
+// Returns false if the ring was full; the trigger is dropped and counted.
+bool TriggerQueue_push(const audioTrigger_t *pTrigger);
+
+// Consumer side (the audio playback thread ONLY, lock-free and wait-free).
+// Returns false when no published trigger is waiting.
+bool TriggerQueue_pop(audioTrigger_t *pTrigger);
+
+// Number of triggers dropped because the ring was full.
+unsigned long TriggerQueue_getDroppedCount(void);
+
+#endif
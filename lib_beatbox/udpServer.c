@@ -6,12 +6,31 @@
  * * It supports both "Getter" and "Setter" styles:
  * - "volume"      -> Returns current volume
  * - "volume 50"   -> Sets volume to 50 and returns new value
+ * * The socket is nonblocking and waited on with epoll. Each wakeup drains up to a
+ * batch of datagrams with one recvmmsg() and answers them with one sendmmsg(), so
+ * a burst of commands costs epoll_wait + recvmmsg + sendmmsg rather than two
+ * syscalls per command (a lone command costs three instead of two, and a full
+ * batch one more recvmmsg to find the socket empty). An eventfd in the same epoll
+ * set wakes the thread when it is asked to stop.
+ * * Datagrams starting with CONTROL_MAGIC use the binary protocol instead (see
+ * controlProtocol.h): fixed-size header, opcode looked up in a table, int32
+ * arguments, so high-rate trigger sources skip the text parsing.
  */
 
+#define _GNU_SOURCE // recvmmsg/sendmmsg
+
 #include "udpServer.h"
+#include "controlProtocol.h"
 #include "beatGenerator.h" 
 #include "audioMixer.h"  
+#include "sampleBank.h"
+#include "voiceAllocator.h"
+#include "rtProfile.h"
 #include "inputMan.h"  
+#include "intervalTimer.h"
+#include "probe.h"
+#include "trace.h"
+#include "logger.h"
 #include <pthread.h>
 #include <string.h>
 #include <stdio.h>
@@ -19,37 +38,118 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
 
 // --- Configuration Constants ---
 
 #define UDP_PORT 12345        // Port to listen on (must match Node.js server)
 #define RX_BUFFER_SIZE 1024   // Max size of a single UDP packet
+#define KIT_ROOT "."          // Folder that holds the kits the "kit" command may load
+#define UDP_BATCH_SIZE 32     // Datagrams received (and replies sent) per syscall
+
+// Throughput benchmark: bursts of a command from one local client
+#define BENCH_TEXT_PLAY  "play 0 0.8 -0.5 1.2"
+#define BENCH_SECONDS    1
+#define BENCH_TIMEOUT_MS 200
 
 // --- Internal State ---
 
 static pthread_t s_threadId;
 static int s_socketFd = -1;
+static int s_wakeFd = -1;       // eventfd: written by UdpServer_cleanup to stop the thread
 static volatile bool s_wantQuit = false;
+static atomic_bool s_listening; // Socket bound and served (the benchmark waits for this)
+
+// Benchmark baseline: serve with the blocking recvfrom/sendto loop the epoll loop replaced
+static bool s_recvfromLoop = false;
 
-// Pointers to the sound data for the "play" command
-static wavedata_t* s_pBaseSound = NULL;
-static wavedata_t* s_pSnareSound = NULL;
-static wavedata_t* s_pHiHatSound = NULL;
+// Receive and reply batches. Only the listener thread touches them.
+static char s_rxBufs[UDP_BATCH_SIZE][RX_BUFFER_SIZE];
+static struct sockaddr_in s_rxAddrs[UDP_BATCH_SIZE];
+static struct iovec s_rxIov[UDP_BATCH_SIZE];
+static struct mmsghdr s_rxMsgs[UDP_BATCH_SIZE];
+
+static char s_txBufs[UDP_BATCH_SIZE][RX_BUFFER_SIZE];
+static struct sockaddr_in s_txAddrs[UDP_BATCH_SIZE];
+static struct iovec s_txIov[UDP_BATCH_SIZE];
+static struct mmsghdr s_txMsgs[UDP_BATCH_SIZE];
+static int s_numReplies = 0;
+
+// Socket syscalls made by the listener thread, for the benchmark
+static atomic_ulong s_numSyscalls;
 
 // --- Private Helpers ---
 
+// Send every queued reply, in as few sendmmsg() calls as the socket allows
+static void flush_replies(void) {
+    int sent = 0;
+    while (sent < s_numReplies) {
+        int r = sendmmsg(s_socketFd, &s_txMsgs[sent], s_numReplies - sent, 0);
+        atomic_fetch_add_explicit(&s_numSyscalls, 1, memory_order_relaxed);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            // Socket buffer full (or the client went away): drop the rest, like a lost datagram
+            LOG_LIMITED(LOG_LEVEL_WARN, "UDP: Dropped %d replies: %s", s_numReplies - sent, strerror(errno));
+            break;
+        }
+        sent += r;
+    }
+    s_numReplies = 0;
+}
+
+// Queue a response back to the sender. The replies to a batch of commands go out
+// together once the whole batch has been handled.
+static void queue_reply(const void *pData, size_t len, struct sockaddr_in *cli, socklen_t clen) {
+    if (s_recvfromLoop) {
+        sendto(s_socketFd, pData, len, 0, (struct sockaddr*)cli, clen);
+        atomic_fetch_add_explicit(&s_numSyscalls, 1, memory_order_relaxed);
+        return;
+    }
+    if (s_numReplies == UDP_BATCH_SIZE) {
+        flush_replies();
+    }
+    int i = s_numReplies++;
+    memcpy(s_txBufs[i], pData, len);
+    memcpy(&s_txAddrs[i], cli, sizeof(s_txAddrs[i]));
+    s_txIov[i].iov_base = s_txBufs[i];
+    s_txIov[i].iov_len = len;
+    memset(&s_txMsgs[i], 0, sizeof(s_txMsgs[i]));
+    s_txMsgs[i].msg_hdr.msg_name = &s_txAddrs[i];
+    s_txMsgs[i].msg_hdr.msg_namelen = clen;
+    s_txMsgs[i].msg_hdr.msg_iov = &s_txIov[i];
+    s_txMsgs[i].msg_hdr.msg_iovlen = 1;
+}
+
+// Resolve a kit name from the network against KIT_ROOT. Only plain folder names are
+// accepted, so a client cannot make the loader (and its cache write) touch other paths.
+static bool resolve_kit_name(const char *name, char *pPath, size_t size) {
+    if (name[0] == '\0' || strchr(name, '/') != NULL || strstr(name, "..") != NULL) {
+        return false;
+    }
+    int len = snprintf(pPath, size, "%s/%s", KIT_ROOT, name);
+    return len > 0 && (size_t)len < size;
+}
+
 // Helper to send a string response back to the sender
 static void send_reply(const char *s, struct sockaddr_in *cli, socklen_t clen) {
-    if (s_socketFd != -1) {
-        sendto(s_socketFd, s, strlen(s), 0, (struct sockaddr*)cli, clen);
-    }
+    queue_reply(s, strlen(s), cli, clen);
 }
 
 // Command Parser
 // Decodes the text command and executes the corresponding action.
 static void handle_command(char* cmd, struct sockaddr_in *cli, socklen_t clen) {
+    PROBE_SCOPE("udp-cmd");
+    Trace_event(TRACE_UDP_COMMAND, (int)strlen(cmd), 0);
     char reply[RX_BUFFER_SIZE] = "";
+
+    // Someone is using the drum machine: poll the inputs at the full rate again
+    InputMan_notifyActivity();
     
     // --- VOLUME Command ---
     if (strncmp(cmd, "volume", 6) == 0) {
@@ -77,29 +177,149 @@ static void handle_command(char* cmd, struct sockaddr_in *cli, socklen_t clen) {
             sprintf(reply, "%d", BeatGenerator_getTempo());
         }
     }
+    // --- MODES Command ---
+    // Lists every selectable pattern as "<index>:<name>" pairs
+    else if (strncmp(cmd, "modes", 5) == 0) {
+        int len = 0;
+        int numModes = BeatGenerator_getNumModes();
+        for (int i = 0; i < numModes && len < RX_BUFFER_SIZE - 40; i++) {
+            len += snprintf(reply + len, RX_BUFFER_SIZE - len, "%s%d:%s",
+                            (i > 0) ? " " : "", i, BeatGenerator_getModeName((BeatMode)i));
+        }
+    }
     // --- MODE Command ---
     else if (strncmp(cmd, "mode", 4) == 0) {
         int newMode;
         if (sscanf(cmd, "mode %d", &newMode) == 1) {
+            // Any loaded pattern index is accepted; invalid ones leave the mode unchanged
             BeatGenerator_setMode((BeatMode)newMode);
-            sprintf(reply, "%d", newMode);
+            sprintf(reply, "%d", BeatGenerator_getMode());
         }
         else {
             sprintf(reply, "%d", BeatGenerator_getMode());
         }
     }
+    // --- SOUNDS Command ---
+    // Lists every sound in the sample bank as "<id>:<name>" pairs
+    else if (strncmp(cmd, "sounds", 6) == 0) {
+        int len = 0;
+        char name[SAMPLEBANK_NAME_LEN];
+        for (int i = 0; SampleBank_getName(i, name, sizeof(name)) && len < RX_BUFFER_SIZE - SAMPLEBANK_NAME_LEN - 8; i++) {
+            len += snprintf(reply + len, RX_BUFFER_SIZE - len, "%s%d:%s", (i > 0) ? " " : "", i, name);
+        }
+    }
     // --- PLAY Command ---
-    // Allows the web interface to trigger individual drum sounds
+    // Triggers any sound in the bank, by ID ("play 7") or by name/alias ("play snare"),
+    // optionally with gain, pan and pitch: "play snare 0.8 -0.5 1.2"
     else if (strncmp(cmd, "play", 4) == 0) {
-        int soundId;
-        if (sscanf(cmd, "play %d", &soundId) == 1) {
-             switch(soundId) {
-                case 0: AudioMixer_queueSound(s_pBaseSound); break;
-                case 1: AudioMixer_queueSound(s_pHiHatSound); break;
-                case 2: AudioMixer_queueSound(s_pSnareSound); break;
+        int soundId = -1;
+        char name[SAMPLEBANK_NAME_LEN];
+        audioVoiceParams_t params = AUDIOMIXER_VOICE_DEFAULTS;
+        if (sscanf(cmd, "play %47s %f %f %f", name, &params.gain, &params.pan, &params.pitch) >= 1) {
+            char *end;
+            long id = strtol(name, &end, 10);
+            soundId = (*end == '\0') ? (int)id : SampleBank_findByName(name);
+        }
+        if (soundId >= 0 && soundId < SampleBank_getCount()) {
+            SampleBank_playWith(soundId, AUDIOMIXER_FRAME_NOW, &params);
+            sprintf(reply, "1"); // Acknowledge
+        } else {
+            sprintf(reply, "Error: Unknown sound");
+        }
+    }
+    // --- POLYPHONY Command ---
+    // Voices that may sound at once; past it the oldest/quietest voice is faded out
+    else if (strncmp(cmd, "polyphony", 9) == 0) {
+        int newPolyphony;
+        if (sscanf(cmd, "polyphony %d", &newPolyphony) == 1) {
+            VoiceAlloc_setPolyphony(newPolyphony);
+        }
+        sprintf(reply, "%d", VoiceAlloc_getPolyphony());
+    }
+    // --- KIT Command ---
+    // "kit <name>" loads another drum kit from KIT_ROOT in the background and swaps
+    // it in without stopping playback; "kit" reports the current kit folder.
+    else if (strncmp(cmd, "kit", 3) == 0) {
+        char name[RX_BUFFER_SIZE];
+        char path[RX_BUFFER_SIZE];
+        if (sscanf(cmd, "kit %1023s", name) == 1) {
+            if (!resolve_kit_name(name, path, sizeof(path))) {
+                sprintf(reply, "Error: Invalid kit name");
+            }
+            else if (SampleBank_loadAsync(path)) {
+                sprintf(reply, "Loading %.1000s", path);
+            } else {
+                sprintf(reply, "Error: Kit load in progress");
             }
         }
-        sprintf(reply, "1"); // Acknowledge
+        else if (SampleBank_getKitPath(path, sizeof(path))) {
+            snprintf(reply, RX_BUFFER_SIZE, "%.1000s%s", path, SampleBank_isLoading() ? " (loading)" : "");
+        }
+    }
+    // --- STATS Command ---
+    // Playback health: periods rendered, DSP load histogram (10% buckets, then
+    // missed deadlines), worst load, under-runs and dropped triggers
+    else if (strncmp(cmd, "stats", 5) == 0) {
+        audioMixerStats_t stats;
+        AudioMixer_getStats(&stats);
+
+        int len = snprintf(reply, RX_BUFFER_SIZE, "periods:%lu load:", stats.periods);
+        for (int i = 0; i < AUDIOMIXER_LOAD_BUCKETS - 1; i++) {
+            len += snprintf(reply + len, RX_BUFFER_SIZE - len, "%s%d%%:%lu", (i > 0) ? "," : "", i * 10, stats.loadHistogram[i]);
+        }
+        len += snprintf(reply + len, RX_BUFFER_SIZE - len, ",late:%lu peak:%.1f%% xruns:%lu failed:%lu",
+                        stats.loadHistogram[AUDIOMIXER_LOAD_BUCKETS - 1], stats.peakLoad * 100.0,
+                        stats.xruns, stats.xrunFailures);
+        if (stats.lastXrunNs != 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long long agoNs = now.tv_sec * 1000000000LL + now.tv_nsec - stats.lastXrunNs;
+            len += snprintf(reply + len, RX_BUFFER_SIZE - len, " last-xrun:%.1fs-ago", agoNs / 1e9);
+        }
+        snprintf(reply + len, RX_BUFFER_SIZE - len, " drops:q%lu,v%lu", stats.queueDrops, stats.voiceDrops);
+    }
+    // --- TIMING Command ---
+    // "timing": p50/p99/max of every interval type and probe over the current
+    // one-second window, one line each (ms; DSP load in %).
+    // "timing <name>": p50/p90/p99/p99.9/max of one of them, then and over its lifetime.
+    else if (strncmp(cmd, "timing", 6) == 0) {
+        char name[32];
+        bool one = (sscanf(cmd, "timing %31s", name) == 1);
+        int len = 0;
+        for (int type = 0; type < Interval_getCount() && len < RX_BUFFER_SIZE - 200; type++) {
+            if (one && strcmp(name, Interval_getName(type)) != 0) {
+                continue;
+            }
+            len += snprintf(reply + len, RX_BUFFER_SIZE - len, "%s%s", (len > 0) ? "\n" : "", Interval_getName(type));
+            for (int window = INTERVAL_WINDOW_CURRENT; window <= (one ? INTERVAL_WINDOW_LIFETIME : INTERVAL_WINDOW_CURRENT); window++) {
+                IntervalSummary sum;
+                const char *label = (window == INTERVAL_WINDOW_CURRENT) ? "1s" : "all";
+                if (!Interval_getSummary(type, window, &sum)) {
+                    len += snprintf(reply + len, RX_BUFFER_SIZE - len, one ? " %s[-]" : " -", label);
+                } else if (one) {
+                    len += snprintf(reply + len, RX_BUFFER_SIZE - len,
+                                    " %s[n:%llu p50:%.3f p90:%.3f p99:%.3f p99.9:%.3f max:%.3f]",
+                                    label, sum.count, sum.p50, sum.p90, sum.p99, sum.p999, sum.max);
+                } else {
+                    len += snprintf(reply + len, RX_BUFFER_SIZE - len, " n:%llu p50:%.3f p99:%.3f max:%.3f",
+                                    sum.count, sum.p50, sum.p99, sum.max);
+                }
+            }
+        }
+        if (len == 0) {
+            sprintf(reply, "Error: Unknown timer");
+        }
+    }
+    // --- TRACE Command ---
+    // "trace" writes the event trace of every thread as Chrome trace JSON to
+    // TRACE_DEFAULT_PATH (a client never picks the file that gets written)
+    else if (strncmp(cmd, "trace", 5) == 0) {
+        int count = Trace_dump(TRACE_DEFAULT_PATH);
+        if (count >= 0) {
+            snprintf(reply, RX_BUFFER_SIZE, "Wrote %d events to %s", count, TRACE_DEFAULT_PATH);
+        } else {
+            sprintf(reply, "Error: Could not write trace");
+        }
     }
     // --- STOP Command ---
     // Terminates the main application loop
@@ -114,13 +334,255 @@ static void handle_command(char* cmd, struct sockaddr_in *cli, socklen_t clen) {
     send_reply(reply, cli, clen);
 }
 
+// --- Binary Commands ---
+// Each opcode has a fixed argument count and a handler that takes the decoded
+// arguments and fills in its results (see controlProtocol.h for the wire format).
+
+typedef ControlStatus (*binaryHandler_t)(const int32_t *pArgs, int32_t *pResults, int *pNumResults);
+
+typedef struct {
+    int numArgs;
+    binaryHandler_t handler;
+} binaryCommand_t;
+
+static ControlStatus bin_get_volume(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    (void)pArgs;
+    pResults[0] = AudioMixer_getVolume();
+    *pNumResults = 1;
+    return CONTROL_STATUS_OK;
+}
+
+static ControlStatus bin_set_volume(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    AudioMixer_setVolume(pArgs[0]);
+    InputMan_notifyManualVolumeSet();
+    return bin_get_volume(pArgs, pResults, pNumResults);
+}
+
+static ControlStatus bin_get_tempo(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    (void)pArgs;
+    pResults[0] = BeatGenerator_getTempo();
+    *pNumResults = 1;
+    return CONTROL_STATUS_OK;
+}
+
+static ControlStatus bin_set_tempo(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    BeatGenerator_setTempo(pArgs[0]);
+    return bin_get_tempo(pArgs, pResults, pNumResults);
+}
+
+static ControlStatus bin_get_mode(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    (void)pArgs;
+    pResults[0] = BeatGenerator_getMode();
+    *pNumResults = 1;
+    return CONTROL_STATUS_OK;
+}
+
+static ControlStatus bin_set_mode(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    // Like the text command, invalid pattern indexes leave the mode unchanged
+    BeatGenerator_setMode((BeatMode)pArgs[0]);
+    return bin_get_mode(pArgs, pResults, pNumResults);
+}
+
+static ControlStatus bin_play(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    (void)pResults;
+    (void)pNumResults;
+    int soundId = pArgs[0];
+    if (soundId < 0 || soundId >= SampleBank_getCount()) {
+        return CONTROL_STATUS_BAD_ARGUMENT;
+    }
+    audioVoiceParams_t params = AUDIOMIXER_VOICE_DEFAULTS;
+    params.gain = pArgs[1] / (float)CONTROL_FIXED_ONE;
+    params.pan = pArgs[2] / (float)CONTROL_FIXED_ONE;
+    params.pitch = pArgs[3] / (float)CONTROL_FIXED_ONE;
+    SampleBank_playWith(soundId, AUDIOMIXER_FRAME_NOW, &params);
+    return CONTROL_STATUS_OK;
+}
+
+static ControlStatus bin_get_polyphony(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    (void)pArgs;
+    pResults[0] = VoiceAlloc_getPolyphony();
+    *pNumResults = 1;
+    return CONTROL_STATUS_OK;
+}
+
+static ControlStatus bin_set_polyphony(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    VoiceAlloc_setPolyphony(pArgs[0]);
+    return bin_get_polyphony(pArgs, pResults, pNumResults);
+}
+
+static ControlStatus bin_stop(const int32_t *pArgs, int32_t *pResults, int *pNumResults) {
+    (void)pArgs;
+    (void)pResults;
+    (void)pNumResults;
+    s_wantQuit = true;
+    return CONTROL_STATUS_OK;
+}
+
+static const binaryCommand_t s_binaryCommands[CONTROL_NUM_OPCODES] = {
+    [CONTROL_OP_GET_VOLUME]    = { 0, bin_get_volume },
+    [CONTROL_OP_SET_VOLUME]    = { 1, bin_set_volume },
+    [CONTROL_OP_GET_TEMPO]     = { 0, bin_get_tempo },
+    [CONTROL_OP_SET_TEMPO]     = { 1, bin_set_tempo },
+    [CONTROL_OP_GET_MODE]      = { 0, bin_get_mode },
+    [CONTROL_OP_SET_MODE]      = { 1, bin_set_mode },
+    [CONTROL_OP_PLAY]          = { 4, bin_play },
+    [CONTROL_OP_GET_POLYPHONY] = { 0, bin_get_polyphony },
+    [CONTROL_OP_SET_POLYPHONY] = { 1, bin_set_polyphony },
+    [CONTROL_OP_STOP]          = { 0, bin_stop },
+};
+
+static int32_t read_le32(const uint8_t *p) {
+    return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static void write_le32(uint8_t *p, int32_t value) {
+    uint32_t v = (uint32_t)value;
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Binary Parser
+// Checks the header, looks the opcode up in s_binaryCommands and answers with the
+// request ID echoed back.
+static void handle_binary(const uint8_t *pRequest, size_t len, struct sockaddr_in *cli, socklen_t clen) {
+    PROBE_SCOPE("udp-bin");
+    Trace_event(TRACE_UDP_COMMAND, (int)len, 0);
+
+    InputMan_notifyActivity();
+
+    if (len < CONTROL_HEADER_SIZE) {
+        // No room for a request ID, so nothing a client could match a reply to
+        LOG_LIMITED(LOG_LEVEL_WARN, "UDP: Dropped a %zu-byte binary request", len);
+        return;
+    }
+
+    uint8_t opcode = pRequest[2];
+    uint8_t flags = pRequest[3];
+    const binaryCommand_t *pCommand = (opcode < CONTROL_NUM_OPCODES && s_binaryCommands[opcode].handler)
+                                      ? &s_binaryCommands[opcode] : NULL;
+    int32_t args[CONTROL_MAX_ARGS];
+    int32_t results[CONTROL_MAX_ARGS];
+    int numResults = 0;
+    ControlStatus status;
+    if (pRequest[1] != CONTROL_VERSION) {
+        status = CONTROL_STATUS_BAD_VERSION;
+    } else if (!pCommand) {
+        status = CONTROL_STATUS_UNKNOWN_OPCODE;
+    } else if (len != CONTROL_HEADER_SIZE + pCommand->numArgs * sizeof(int32_t)) {
+        status = CONTROL_STATUS_BAD_LENGTH;
+    } else {
+        for (int i = 0; i < pCommand->numArgs; i++) {
+            args[i] = read_le32(pRequest + CONTROL_HEADER_SIZE + i * sizeof(int32_t));
+        }
+        status = pCommand->handler(args, results, &numResults);
+    }
+
+    if (flags & CONTROL_FLAG_NO_REPLY) {
+        return;
+    }
+    uint8_t reply[CONTROL_HEADER_SIZE + CONTROL_MAX_ARGS * sizeof(int32_t)];
+    reply[0] = CONTROL_MAGIC;
+    reply[1] = CONTROL_VERSION;
+    reply[2] = opcode;
+    reply[3] = (uint8_t)status;
+    memcpy(reply + 4, pRequest + 4, 4); // Request ID, as sent
+    for (int i = 0; i < numResults; i++) {
+        write_le32(reply + CONTROL_HEADER_SIZE + i * sizeof(int32_t), results[i]);
+    }
+    queue_reply(reply, CONTROL_HEADER_SIZE + numResults * sizeof(int32_t), cli, clen);
+}
+
 // --- Main UDP Thread ---
 
+// Receive every waiting datagram, a batch per recvmmsg(), and answer each batch with
+// one sendmmsg(). Returns once the socket has been drained.
+static void drain_socket(void) {
+    while (!s_wantQuit) {
+        for (int i = 0; i < UDP_BATCH_SIZE; i++) {
+            s_rxIov[i].iov_base = s_rxBufs[i];
+            s_rxIov[i].iov_len = RX_BUFFER_SIZE - 1;
+            memset(&s_rxMsgs[i], 0, sizeof(s_rxMsgs[i]));
+            s_rxMsgs[i].msg_hdr.msg_name = &s_rxAddrs[i];
+            s_rxMsgs[i].msg_hdr.msg_namelen = sizeof(s_rxAddrs[i]);
+            s_rxMsgs[i].msg_hdr.msg_iov = &s_rxIov[i];
+            s_rxMsgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = recvmmsg(s_socketFd, s_rxMsgs, UDP_BATCH_SIZE, 0, NULL);
+        atomic_fetch_add_explicit(&s_numSyscalls, 1, memory_order_relaxed);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_LIMITED(LOG_LEVEL_ERROR, "UDP: Error receiving: %s", strerror(errno));
+            }
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            char *buf = s_rxBufs[i];
+            size_t r = s_rxMsgs[i].msg_len;
+
+            if (r > 0 && (uint8_t)buf[0] == CONTROL_MAGIC) {
+                handle_binary((const uint8_t*)buf, r, &s_rxAddrs[i], s_rxMsgs[i].msg_hdr.msg_namelen);
+                continue;
+            }
+
+            // Null-terminate the received string
+            buf[r] = '\0';
+
+            // Clean up whitespace (newlines) from the end of the command
+            while (r > 0 && (buf[r-1] == '\n' || buf[r-1] == '\r')) buf[--r] = '\0';
+
+            if (r > 0) {
+                handle_command(buf, &s_rxAddrs[i], s_rxMsgs[i].msg_hdr.msg_namelen);
+            }
+        }
+        flush_replies();
+
+        // A short batch means the socket is empty; epoll reports anything newer
+        if (n < UDP_BATCH_SIZE) return;
+    }
+}
+
+// Benchmark baseline: one blocking recvfrom() and one sendto() per command.
+// UdpServer_cleanup shuts the socket down to wake it.
+static void recvfrom_loop(void) {
+    char *buf = s_rxBufs[0];
+    while (!s_wantQuit) {
+        struct sockaddr_in clientSin;
+        socklen_t clientLen = sizeof(clientSin);
+        ssize_t r = recvfrom(s_socketFd, buf, RX_BUFFER_SIZE - 1, 0,
+                             (struct sockaddr*)&clientSin, &clientLen);
+        atomic_fetch_add_explicit(&s_numSyscalls, 1, memory_order_relaxed);
+        if (r < 0) {
+            if (s_wantQuit) break;
+            if (errno != EINTR) {
+                LOG_LIMITED(LOG_LEVEL_ERROR, "UDP: Error receiving: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        if (r > 0 && (uint8_t)buf[0] == CONTROL_MAGIC) {
+            handle_binary((const uint8_t*)buf, (size_t)r, &clientSin, clientLen);
+            continue;
+        }
+        buf[r] = '\0';
+        while (r > 0 && (buf[r-1] == '\n' || buf[r-1] == '\r')) buf[--r] = '\0';
+        if (r > 0) {
+            handle_command(buf, &clientSin, clientLen);
+        }
+    }
+}
+
 static void* udpListenerThread(void *arg) {
     (void)arg;
+    RtProfile_applyToCurrentThread(RT_ROLE_CONTROL, "udp");
     
-    // 1. Create Socket
-    if ((s_socketFd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    // 1. Create Socket (nonblocking: epoll says when to read; the baseline blocks)
+    int type = SOCK_DGRAM | SOCK_CLOEXEC | (s_recvfromLoop ? 0 : SOCK_NONBLOCK);
+    if ((s_socketFd = socket(AF_INET, type, 0)) < 0) {
         perror("UDP: socket failed");
         return NULL;
     }
@@ -138,37 +600,53 @@ static void* udpListenerThread(void *arg) {
         s_socketFd = -1;
         return NULL;
     }
+
+    if (s_recvfromLoop) {
+        atomic_store(&s_listening, true);
+        recvfrom_loop();
+        atomic_store(&s_listening, false);
+        close(s_socketFd);
+        s_socketFd = -1;
+        return NULL;
+    }
+
+    // 3. Wait on the socket and the stop eventfd together
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event sockEvent = { .events = EPOLLIN, .data.fd = s_socketFd };
+    struct epoll_event wakeEvent = { .events = EPOLLIN, .data.fd = s_wakeFd };
+    if (epollFd < 0
+            || epoll_ctl(epollFd, EPOLL_CTL_ADD, s_socketFd, &sockEvent) < 0
+            || epoll_ctl(epollFd, EPOLL_CTL_ADD, s_wakeFd, &wakeEvent) < 0) {
+        perror("UDP: epoll failed");
+        if (epollFd >= 0) close(epollFd);
+        close(s_socketFd);
+        s_socketFd = -1;
+        return NULL;
+    }
     
     printf("UDP Server listening on port %d...\n", UDP_PORT);
+    atomic_store(&s_listening, true);
 
-    char buf[RX_BUFFER_SIZE];
-    struct sockaddr_in clientSin;
-    socklen_t clientLen = sizeof(clientSin);
-    
-    // 3. Listen Loop
+    // 4. Event Loop
     while (!s_wantQuit) {
-        // Blocks here until data arrives
-        ssize_t r = recvfrom(s_socketFd, buf, RX_BUFFER_SIZE - 1, 0,
-                             (struct sockaddr*)&clientSin, &clientLen);
-
-        if (r < 0) {
-            // Check if we were woken up by a shutdown signal
-            if (s_wantQuit) break; 
-            perror("UDP: Error receiving");
-            continue;
+        struct epoll_event events[2];
+        int n = epoll_wait(epollFd, events, 2, -1);
+        atomic_fetch_add_explicit(&s_numSyscalls, 1, memory_order_relaxed);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_LIMITED(LOG_LEVEL_ERROR, "UDP: epoll_wait failed: %s", strerror(errno));
+            break;
         }
-
-        // Null-terminate the received string
-        buf[r] = '\0';
-        
-        // Clean up whitespace (newlines) from the end of the command
-        while (r > 0 && (buf[r-1] == '\n' || buf[r-1] == '\r')) buf[--r] = '\0';
-
-        if (r > 0) {
-            handle_command(buf, &clientSin, clientLen);
+        for (int i = 0; i < n; i++) {
+            // The eventfd only wakes us: s_wantQuit is already set
+            if (events[i].data.fd == s_socketFd) {
+                drain_socket();
+            }
         }
     }
 
+    atomic_store(&s_listening, false);
+    close(epollFd);
     close(s_socketFd);
     s_socketFd = -1;
     return NULL;
@@ -176,21 +654,169 @@ static void* udpListenerThread(void *arg) {
 
 // --- Public API ---
 
-void UdpServer_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat) {
-    s_pBaseSound = pBase;
-    s_pSnareSound = pSnare;
-    s_pHiHatSound = pHiHat;
+void UdpServer_init(void) {
     s_wantQuit = false;
+    s_wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (s_wakeFd < 0) {
+        perror("UDP: eventfd failed");
+        return;
+    }
     pthread_create(&s_threadId, NULL, udpListenerThread, NULL);
 }
 
 void UdpServer_cleanup(void) {
     s_wantQuit = true;
-    if (s_socketFd != -1) {
+    if (s_wakeFd == -1) {
+        return;
+    }
+    if (s_recvfromLoop && s_socketFd != -1) {
         // Shutdown the socket to force recvfrom() to unblock and return
         shutdown(s_socketFd, SHUT_RD);
     }
+    // Wake epoll_wait() so the thread sees s_wantQuit
+    uint64_t one = 1;
+    if (write(s_wakeFd, &one, sizeof(one)) != sizeof(one)) {
+        perror("UDP: eventfd write failed");
+    }
     pthread_join(s_threadId, NULL);
+    close(s_wakeFd);
+    s_wakeFd = -1;
+}
+
+// --- Benchmark ---
+
+// One "play" request in each protocol. No kit is loaded while the benchmark runs,
+// so both are parsed and answered with an error without starting a voice.
+static const uint8_t s_benchBinaryPlay[CONTROL_HEADER_SIZE + 4 * sizeof(int32_t)] = {
+    CONTROL_MAGIC, CONTROL_VERSION, CONTROL_OP_PLAY, 0, 1, 0, 0, 0,
+    0, 0, 0, 0,                 // Sound 0
+    0x20, 0x03, 0, 0,           // Gain 0.8
+    0x0C, 0xFE, 0xFF, 0xFF,     // Pan -0.5
+    0xB0, 0x04, 0, 0,           // Pitch 1.2
+};
+
+// Client side of the benchmark: send bursts of one request to the server and wait
+// for every reply, for BENCH_SECONDS. Returns the commands answered per second.
+static double bench_client(const void *pRequest, size_t len, int burst, unsigned long *pAnswered, unsigned long *pLost) {
+    *pAnswered = 0;
+    *pLost = 0;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("UDP: benchmark socket failed");
+        return 0;
+    }
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = BENCH_TIMEOUT_MS * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server.sin_port = htons(UDP_PORT);
+    if (connect(fd, (struct sockaddr*)&server, sizeof(server)) < 0) {
+        perror("UDP: benchmark connect failed");
+        close(fd);
+        return 0;
+    }
+
+    unsigned long answered = 0;
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    double elapsed = 0;
+    char reply[RX_BUFFER_SIZE];
+    while (elapsed < BENCH_SECONDS) {
+        for (int i = 0; i < burst; i++) {
+            send(fd, pRequest, len, 0);
+        }
+        for (int i = 0; i < burst; i++) {
+            if (recv(fd, reply, sizeof(reply), 0) < 0) {
+                // Timed out: the rest of this burst was lost
+                *pLost += burst - i;
+                break;
+            }
+            answered++;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    }
+    close(fd);
+    *pAnswered = answered;
+    return answered / elapsed;
+}
+
+// Interval type of a timing probe, or -1 if it has not recorded anything yet
+static int find_probe(const char *name) {
+    for (int type = 0; type < Interval_getCount(); type++) {
+        if (strcmp(Interval_getName(type), name) == 0) {
+            return type;
+        }
+    }
+    return -1;
+}
+
+int UdpServer_runBenchmark(void) {
+    static const int bursts[] = { 1, 8, UDP_BATCH_SIZE };
+    static const struct { const char *name; bool recvfromLoop; } servers[] = {
+        { "recvfrom/sendto", true },
+        { "epoll batched", false },
+    };
+    static const struct {
+        const char *name;
+        const char *probe;          // Timing probe around its parser (see handle_command)
+        const void *pRequest;
+        size_t len;
+    } protocols[] = {
+        { "text",   "udp-cmd", BENCH_TEXT_PLAY, sizeof(BENCH_TEXT_PLAY) - 1 },
+        { "binary", "udp-bin", s_benchBinaryPlay, sizeof(s_benchBinaryPlay) },
+    };
+    enum { NUM_BURSTS = sizeof(bursts) / sizeof(bursts[0]) };
+    enum { NUM_SERVERS = sizeof(servers) / sizeof(servers[0]) };
+    enum { NUM_PROTOCOLS = sizeof(protocols) / sizeof(protocols[0]) };
+
+    printf("UDP benchmark: \"%s\" and its binary form over loopback, %d s per run.\n", BENCH_TEXT_PLAY, BENCH_SECONDS);
+    printf("The recvfrom/sendto server replies from inside the handler, so its handler time includes the sendto().\n");
+    printf("server           proto   burst  commands/s  syscalls/command  handler p50 us  lost\n");
+
+    int result = 0;
+    for (int s = 0; s < NUM_SERVERS && result == 0; s++) {
+        s_recvfromLoop = servers[s].recvfromLoop;
+        atomic_store(&s_listening, false);
+        UdpServer_init();
+        // Wait (up to a second) for the socket to be bound
+        for (int wait = 0; wait < 1000 && !atomic_load(&s_listening); wait++) {
+            usleep(1000);
+        }
+        if (!atomic_load(&s_listening)) {
+            printf("UDP: The benchmark could not start the server (port %d in use?).\n", UDP_PORT);
+            result = -1;
+        }
+
+        for (int p = 0; p < NUM_PROTOCOLS && result == 0; p++) {
+            for (int i = 0; i < NUM_BURSTS; i++) {
+                int probe = find_probe(protocols[p].probe);
+                if (probe >= 0) {
+                    Interval_reset(probe);
+                }
+                unsigned long answered, lost;
+                unsigned long syscallsBefore = atomic_load(&s_numSyscalls);
+                double rate = bench_client(protocols[p].pRequest, protocols[p].len, bursts[i], &answered, &lost);
+                // The client waits for every reply, so the server is idle when these are read
+                unsigned long syscalls = atomic_load(&s_numSyscalls) - syscallsBefore;
+                double perCommand = (answered > 0) ? (double)syscalls / answered : 0;
+                IntervalSummary handler;
+                probe = find_probe(protocols[p].probe);
+                if (probe >= 0 && Interval_getSummary(probe, INTERVAL_WINDOW_CURRENT, &handler)) {
+                    printf("%-15s  %-6s %6d %11.0f %17.2f %15.2f %5lu\n", servers[s].name, protocols[p].name,
+                           bursts[i], rate, perCommand, handler.p50 * 1000.0, lost);
+                } else {
+                    printf("%-15s  %-6s %6d %11.0f %17.2f %15s %5lu\n", servers[s].name, protocols[p].name,
+                           bursts[i], rate, perCommand, "-", lost);
+                }
+            }
+        }
+        UdpServer_cleanup();
+    }
+    s_recvfromLoop = false;
+    return result;
 }
 
 int UdpServer_shouldQuit(void) {
@@ -1,15 +1,21 @@
 #ifndef UDPSERVER_H
 #define UDPSERVER_H
 
-#include "audioMixer.h"
-
 // Initializes the UDP listening thread.
-// Takes pointers to the sounds so the "play" command can trigger them.
-void UdpServer_init(wavedata_t* pBase, wavedata_t* pSnare, wavedata_t* pHiHat);
+// The "play" command triggers sounds straight from the sample bank. Binary requests
+// (see controlProtocol.h) are served on the same port.
+void UdpServer_init(void);
 
 // Stops the thread and closes the socket.
 void UdpServer_cleanup(void);
 
+// Throughput benchmark over loopback: bursts of "play" commands, text and binary, from
+// a local client, served first by a blocking recvfrom/sendto loop (the baseline) and
+// then by the epoll loop. Prints commands per second, syscalls per command and the
+// time spent handling one command. Call instead of UdpServer_init().
+// Returns 0 on success, -1 if the server could not be started.
+int UdpServer_runBenchmark(void);
+
 // Returns 1 if a "stop" command has been received, 0 otherwise.
 // Used by the main loop to decide when to exit.
 int UdpServer_shouldQuit(void);
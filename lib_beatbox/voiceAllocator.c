@@ -0,0 +1,241 @@
+/*
+ * Voice Allocator Module
+ * * Hands out the mixer's voice slots. Owned by the playback thread, so none of
+ * it needs locks; other threads only change the settings (atomics).
+ * * Design:
+ * - Free slots are a stack and active voices a dense list (each voice remembers
+ *   its position in it), so allocating, ending and iterating are all O(1) per voice.
+ * - Polyphony is a soft limit on voices that are still sounding. Past it, the
+ *   oldest or quietest voice is released: it fades out over a few milliseconds
+ *   (no click) while the new voice starts in another slot.
+ * - Choke groups: a new voice releases the other voices of its group, e.g. a
+ *   closed hi-hat cuts the open one, and fast hi-hat patterns do not pile up tails.
+ */
+
+#include "voiceAllocator.h"
+#include <string.h>
+#include <stdatomic.h>
+
+// --- Internal State ---
+
+static mixerVoice_t s_voices[VOICEALLOC_MAX_VOICES];
+
+static int s_freeSlots[VOICEALLOC_MAX_VOICES]; // Stack of free slot indices
+static int s_numFree = 0;
+
+static int s_active[VOICEALLOC_MAX_VOICES];    // Slot indices of active voices
+static int s_activePos[VOICEALLOC_MAX_VOICES]; // Position of each slot in s_active
+static int s_numActive = 0;
+static int s_numReleased = 0;                  // Active voices that are fading out
+
+static unsigned long long s_nextSerial = 0;
+
+static atomic_int s_polyphony = VOICEALLOC_DEFAULT_POLYPHONY;
+static atomic_int s_stealMode = VOICE_STEAL_OLDEST;
+static atomic_int s_publishedActive = 0;
+static atomic_ulong s_stolenCount = 0;
+static atomic_ulong s_chokedCount = 0;
+
+// --- Private Helpers ---
+
+static bool isReleasing(const mixerVoice_t *pVoice)
+{
+    return pVoice->released;
+}
+
+// Rough loudness of what is left of a voice: its gain scaled by the fraction of
+// the sample still to play (drum samples decay, so later means quieter).
+static int64_t voiceLevel(const mixerVoice_t *pVoice)
+{
+    int32_t gain = (pVoice->gainLeftQ15 > pVoice->gainRightQ15) ? pVoice->gainLeftQ15 : pVoice->gainRightQ15;
+    int numSamples = pVoice->pSound->numSamples;
+    int played = (pVoice->location > 0) ? pVoice->location : 0;
+    return (int64_t)gain * (numSamples - played) / (numSamples > 0 ? numSamples : 1);
+}
+
+// Pick the voice to give way, ignoring ones already fading out.
+static mixerVoice_t* findVictim(void)
+{
+    VoiceStealMode mode = (VoiceStealMode)atomic_load_explicit(&s_stealMode, memory_order_relaxed);
+    mixerVoice_t *pVictim = NULL;
+    int64_t bestLevel = INT64_MAX;
+
+    for (int k = 0; k < s_numActive; k++) {
+        mixerVoice_t *pVoice = &s_voices[s_active[k]];
+        if (pVoice->pSound == NULL || isReleasing(pVoice)) {
+            continue;
+        }
+        if (mode == VOICE_STEAL_QUIETEST) {
+            int64_t level = voiceLevel(pVoice);
+            if (level < bestLevel) {
+                bestLevel = level;
+                pVictim = pVoice;
+            }
+        } else if (!pVictim || pVoice->serial < pVictim->serial) {
+            pVictim = pVoice;
+        }
+    }
+    return pVictim;
+}
+
+static void removeActive(int slot)
+{
+    if (s_voices[slot].released) {
+        s_numReleased--;
+    }
+    int pos = s_activePos[slot];
+    int last = s_active[--s_numActive];
+    s_active[pos] = last;
+    s_activePos[last] = pos;
+    s_freeSlots[s_numFree++] = slot;
+}
+
+// --- Public API ---
+
+void VoiceAlloc_init(void)
+{
+    memset(s_voices, 0, sizeof(s_voices));
+    s_numActive = 0;
+    s_numReleased = 0;
+    s_numFree = 0;
+    for (int slot = VOICEALLOC_MAX_VOICES - 1; slot >= 0; slot--) {
+        s_freeSlots[s_numFree++] = slot; // Lowest slot on top
+    }
+    s_nextSerial = 0;
+    atomic_store(&s_publishedActive, 0);
+    atomic_store(&s_stolenCount, 0);
+    atomic_store(&s_chokedCount, 0);
+}
+
+mixerVoice_t* VoiceAlloc_allocate(void)
+{
+    // Fading voices are on their way out and do not count
+    int sounding = s_numActive - s_numReleased;
+    int polyphony = atomic_load_explicit(&s_polyphony, memory_order_relaxed);
+
+    // Only a full allocator searches for a victim (linear in the voices in use)
+    if (s_numFree == 0 || sounding >= polyphony) {
+        mixerVoice_t *pVictim = findVictim();
+        if (pVictim) {
+            atomic_fetch_add_explicit(&s_stolenCount, 1, memory_order_relaxed);
+            if (s_numFree == 0) {
+                // No slot to fade out in: cut it off and reuse its slot
+                VoiceAlloc_end(pVictim);
+                removeActive((int)(pVictim - s_voices));
+            } else {
+                VoiceAlloc_release(pVictim, 0);
+            }
+        }
+    }
+
+    if (s_numFree == 0) {
+        return NULL;
+    }
+
+    int slot = s_freeSlots[--s_numFree];
+    s_activePos[slot] = s_numActive;
+    s_active[s_numActive++] = slot;
+
+    mixerVoice_t *pVoice = &s_voices[slot];
+    memset(pVoice, 0, sizeof(*pVoice));
+    pVoice->serial = s_nextSerial++;
+    return pVoice;
+}
+
+void VoiceAlloc_choke(int group, int startDelay, const mixerVoice_t *pExcept)
+{
+    if (group <= 0) {
+        return;
+    }
+    for (int k = 0; k < s_numActive; k++) {
+        mixerVoice_t *pVoice = &s_voices[s_active[k]];
+        if (pVoice == pExcept || pVoice->pSound == NULL || pVoice->chokeGroup != group
+                || isReleasing(pVoice)) {
+            continue;
+        }
+        // A voice scheduled to start after the new one is a later hit: leave it
+        int voiceStart = (pVoice->location < 0) ? -pVoice->location : 0;
+        if (voiceStart > startDelay) {
+            continue;
+        }
+        VoiceAlloc_release(pVoice, startDelay - voiceStart);
+        atomic_fetch_add_explicit(&s_chokedCount, 1, memory_order_relaxed);
+    }
+}
+
+void VoiceAlloc_collect(void)
+{
+    // Backwards, so removing (swap with the last) never skips a voice
+    for (int k = s_numActive - 1; k >= 0; k--) {
+        if (s_voices[s_active[k]].pSound == NULL) {
+            removeActive(s_active[k]);
+        }
+    }
+    atomic_store_explicit(&s_publishedActive, s_numActive, memory_order_relaxed);
+}
+
+int VoiceAlloc_getNumActive(void)
+{
+    return s_numActive;
+}
+
+mixerVoice_t* VoiceAlloc_getActive(int index)
+{
+    return &s_voices[s_active[index]];
+}
+
+void VoiceAlloc_release(mixerVoice_t *pVoice, int delayFrames)
+{
+    if (!pVoice->released) {
+        pVoice->released = true;
+        s_numReleased++;
+    }
+    pVoice->releaseDelay = delayFrames;
+    pVoice->releaseFrames = VOICEALLOC_RELEASE_FRAMES;
+}
+
+void VoiceAlloc_end(mixerVoice_t *pVoice)
+{
+    pVoice->pSound = NULL;
+    if (pVoice->pKit) {
+        // Release: our reads of the kit's samples happen before its owner may free it
+        atomic_fetch_sub_explicit(&pVoice->pKit->activeVoices, 1, memory_order_release);
+        pVoice->pKit = NULL;
+    }
+}
+
+void VoiceAlloc_setPolyphony(int polyphony)
+{
+    if (polyphony < 1) polyphony = 1;
+    if (polyphony > VOICEALLOC_MAX_VOICES) polyphony = VOICEALLOC_MAX_VOICES;
+    atomic_store(&s_polyphony, polyphony);
+}
+
+int VoiceAlloc_getPolyphony(void)
+{
+    return atomic_load(&s_polyphony);
+}
+
+void VoiceAlloc_setStealMode(VoiceStealMode mode)
+{
+    atomic_store(&s_stealMode, (int)mode);
+}
+
+VoiceStealMode VoiceAlloc_getStealMode(void)
+{
+    return (VoiceStealMode)atomic_load(&s_stealMode);
+}
+
+bool VoiceAlloc_parseStealMode(const char *name, VoiceStealMode *pMode)
+{
+    if (strcmp(name, "oldest") == 0)   { *pMode = VOICE_STEAL_OLDEST;   return true; }
+    if (strcmp(name, "quietest") == 0) { *pMode = VOICE_STEAL_QUIETEST; return true; }
+    return false;
+}
+
+void VoiceAlloc_getStats(int *pActive, unsigned long *pStolen, unsigned long *pChoked)
+{
+    if (pActive) *pActive = atomic_load_explicit(&s_publishedActive, memory_order_relaxed);
+    if (pStolen) *pStolen = atomic_load_explicit(&s_stolenCount, memory_order_relaxed);
+    if (pChoked) *pChoked = atomic_load_explicit(&s_chokedCount, memory_order_relaxed);
+}
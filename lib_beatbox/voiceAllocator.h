@@ -0,0 +1,84 @@
+#ifndef VOICEALLOCATOR_H
+#define VOICEALLOCATOR_H
+
+#include "audioMixer.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+// Voice slots the mixer has (the most polyphony can be set to)
+#define VOICEALLOC_MAX_VOICES 256
+#define VOICEALLOC_DEFAULT_POLYPHONY 32
+
+// Length of the fade when a voice is stolen or choked (~2.9 ms at 44.1 kHz)
+#define VOICEALLOC_RELEASE_FRAMES 128
+#define VOICEALLOC_RELEASE_STEP_FRAMES 16 // The fade gain is constant within a step
+
+// Which voice gives way when a new hit arrives and polyphony is used up.
+typedef enum {
+    VOICE_STEAL_OLDEST = 0, // The voice that started first
+    VOICE_STEAL_QUIETEST    // The lowest gain x remaining length (drum hits decay)
+} VoiceStealMode;
+
+// One playing (or scheduled, or fading) sound. Owned by the playback thread;
+// a render worker may advance or end a voice it has been handed.
+typedef struct {
+    wavedata_t *pSound;     // Sound being played (NULL = slot free)
+    int location;           // Current index (sample offset) into that data.
+                            // Negative while a scheduled voice waits for its start frame.
+    uint32_t fracQ16;       // Fractional part of the read position (pitched voices)
+    uint32_t stepQ16;       // Read position advance per output frame (0x10000 = original pitch)
+    int32_t gainLeftQ15;
+    int32_t gainRightQ15;
+    audioKit_t *pKit;       // Kit the sound belongs to (NULL for sounds queued by pointer)
+    int chokeGroup;         // 0 = none; a new voice in the group releases the others
+    bool released;          // Stolen or choked: fading out, no longer counts towards polyphony
+    int releaseDelay;       // Released voices: frames of playback before the fade starts
+    int releaseFrames;      // Frames of fade left
+    unsigned long long serial; // Allocation order (for stealing the oldest)
+} mixerVoice_t;
+
+// --- Playback thread only ---
+
+// Mark every slot free. Call before the playback thread starts.
+void VoiceAlloc_init(void);
+
+// Take a slot for a new voice in O(1). When polyphony is used up, a victim is
+// released (faded out) first; if no slot is free at all it is cut off immediately.
+// Returns NULL only if every slot is busy and none can be stolen.
+mixerVoice_t* VoiceAlloc_allocate(void);
+
+// Release every sounding voice in 'group' that starts no later than 'startDelay'
+// frames from now; each fades out once it has played up to that point.
+void VoiceAlloc_choke(int group, int startDelay, const mixerVoice_t *pExcept);
+
+// Return the slots of voices that have ended (see VoiceAlloc_end) to the free list.
+void VoiceAlloc_collect(void);
+
+// Active voices, in no particular order (valid until the next allocate/collect).
+int VoiceAlloc_getNumActive(void);
+mixerVoice_t* VoiceAlloc_getActive(int index);
+
+// Fade the voice out after 'delayFrames' more frames of playback.
+void VoiceAlloc_release(mixerVoice_t *pVoice, int delayFrames);
+
+// --- Playback thread or the render worker holding the voice ---
+
+// Stop the voice and let go of its kit. Its slot is reclaimed by VoiceAlloc_collect.
+void VoiceAlloc_end(mixerVoice_t *pVoice);
+
+// --- Any thread ---
+
+// Number of voices that may sound at once (1 .. VOICEALLOC_MAX_VOICES); takes
+// effect for the next trigger. Fading voices do not count.
+void VoiceAlloc_setPolyphony(int polyphony);
+int VoiceAlloc_getPolyphony(void);
+
+void VoiceAlloc_setStealMode(VoiceStealMode mode);
+VoiceStealMode VoiceAlloc_getStealMode(void);
+bool VoiceAlloc_parseStealMode(const char *name, VoiceStealMode *pMode);
+
+// Voices in use as of the last buffer, and running totals of stolen and choked voices.
+// Any pointer may be NULL.
+void VoiceAlloc_getStats(int *pActive, unsigned long *pStolen, unsigned long *pChoked);
+
+#endif
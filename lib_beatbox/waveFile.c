@@ -0,0 +1,159 @@
+/*
+ * Wave File Module
+ * * A small RIFF/WAVE parser. Instead of assuming a fixed 44-byte header, it walks
+ * the chunk list, validates the "fmt " chunk, and locates the "data" chunk wherever
+ * it is (files from editors and sample packs often carry LIST, fact, or bext chunks
+ * before the audio).
+ * * Files are memory-mapped rather than read, so a sample that is already in the
+ * engine's format can be played directly out of the page cache with zero copies,
+ * and the same kit loaded by several processes shares the same physical pages.
+ */
+
+#include "waveFile.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// --- Configuration Constants ---
+
+#define RIFF_HEADER_SIZE 12  // "RIFF" <size> "WAVE"
+#define CHUNK_HEADER_SIZE 8  // <id> <size>
+#define FMT_MIN_SIZE 16
+#define FMT_EXTENSIBLE_SIZE 40
+#define FORMAT_EXTENSIBLE 0xFFFE
+
+// --- Private Helpers ---
+
+static uint16_t readLE16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLE32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Decode the "fmt " chunk. Returns false if it is malformed.
+static bool parseFormat(const uint8_t *chunk, uint32_t size, waveFile_t *pWave)
+{
+    if (size < FMT_MIN_SIZE) return false;
+
+    pWave->formatTag = readLE16(chunk + 0);
+    pWave->channels = readLE16(chunk + 2);
+    pWave->sampleRate = (int)readLE32(chunk + 4);
+    pWave->blockAlign = readLE16(chunk + 12);
+    pWave->bitsPerSample = readLE16(chunk + 14);
+
+    // WAVE_FORMAT_EXTENSIBLE: the real format tag is the first 2 bytes of the sub-format GUID
+    if (pWave->formatTag == FORMAT_EXTENSIBLE && size >= FMT_EXTENSIBLE_SIZE) {
+        pWave->formatTag = readLE16(chunk + 24);
+    }
+
+    return pWave->channels > 0
+        && pWave->sampleRate > 0
+        && pWave->bitsPerSample > 0
+        && pWave->blockAlign >= pWave->channels * ((pWave->bitsPerSample + 7) / 8);
+}
+
+// --- Public API ---
+
+bool WaveFile_open(const char *fileName, waveFile_t *pWave)
+{
+    memset(pWave, 0, sizeof(*pWave));
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to open file %s.", fileName);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < RIFF_HEADER_SIZE + CHUNK_HEADER_SIZE) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: %s is too small to be a WAV file.", fileName);
+        close(fd);
+        return false;
+    }
+
+    // Map the whole file; MAP_POPULATE faults it in now rather than on the audio thread
+    size_t fileSize = (size_t)st.st_size;
+    void *map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd); // The mapping keeps the file alive
+    if (map == MAP_FAILED) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: Unable to map file %s.", fileName);
+        return false;
+    }
+    pWave->pMapping = map;
+    pWave->mappingSize = fileSize;
+
+    const uint8_t *bytes = map;
+    if (memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        Log_write(LOG_LEVEL_ERROR, "ERROR: %s is not a RIFF/WAVE file.", fileName);
+        WaveFile_close(pWave);
+        return false;
+    }
+
+    // Walk the chunk list. Chunks are padded to an even length.
+    bool haveFormat = false;
+    size_t pos = RIFF_HEADER_SIZE;
+    while (pos + CHUNK_HEADER_SIZE <= fileSize) {
+        const uint8_t *chunk = bytes + pos;
+        uint32_t size = readLE32(chunk + 4);
+        size_t body = pos + CHUNK_HEADER_SIZE;
+        size_t available = fileSize - body;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (size > available || !parseFormat(bytes + body, size, pWave)) {
+                Log_write(LOG_LEVEL_ERROR, "ERROR: %s has an invalid format chunk.", fileName);
+                WaveFile_close(pWave);
+                return false;
+            }
+            haveFormat = true;
+        }
+        else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) {
+                Log_write(LOG_LEVEL_ERROR, "ERROR: %s has audio data before its format chunk.", fileName);
+                WaveFile_close(pWave);
+                return false;
+            }
+            // A truncated file (or a streaming writer's placeholder size) is clipped to what exists
+            if (size > available) {
+                Log_write(LOG_LEVEL_WARN, "WARNING: %s data chunk is truncated (%u of %u bytes).",
+                          fileName, (unsigned)available, size);
+                size = (uint32_t)available;
+            }
+            pWave->pData = bytes + body;
+            pWave->numFrames = size / (size_t)pWave->blockAlign;
+            pWave->dataBytes = pWave->numFrames * (size_t)pWave->blockAlign;
+            return true;
+        }
+
+        pos = body + size + (size & 1);
+    }
+
+    Log_write(LOG_LEVEL_ERROR, "ERROR: %s has no %s chunk.", fileName, haveFormat ? "data" : "format");
+    WaveFile_close(pWave);
+    return false;
+}
+
+void WaveFile_close(waveFile_t *pWave)
+{
+    if (pWave->pMapping) {
+        munmap(pWave->pMapping, pWave->mappingSize);
+    }
+    memset(pWave, 0, sizeof(*pWave));
+}
+
+bool WaveFile_isPcm16(const waveFile_t *pWave, int channels, int sampleRate)
+{
+    return pWave->formatTag == WAVEFILE_FORMAT_PCM
+        && pWave->bitsPerSample == 16
+        && pWave->channels == channels
+        && pWave->sampleRate == sampleRate
+        && pWave->blockAlign == channels * 2
+        && ((uintptr_t)pWave->pData % sizeof(int16_t)) == 0;
+}
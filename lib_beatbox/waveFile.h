@@ -0,0 +1,44 @@
+#ifndef WAVEFILE_H
+#define WAVEFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Format tags found in the "fmt " chunk
+#define WAVEFILE_FORMAT_PCM   1
+#define WAVEFILE_FORMAT_FLOAT 3
+
+// A parsed RIFF/WAVE file, memory-mapped read-only.
+typedef struct {
+    // From the "fmt " chunk (WAVE_FORMAT_EXTENSIBLE is resolved to its sub-format)
+    int formatTag;
+    int channels;
+    int sampleRate;
+    int bitsPerSample;
+    int blockAlign;    // Bytes per frame (all channels)
+
+    // The "data" chunk, pointing straight into the mapping
+    const uint8_t *pData;
+    size_t dataBytes;
+    size_t numFrames;
+
+    // The mapping itself (released by WaveFile_close)
+    void *pMapping;
+    size_t mappingSize;
+} waveFile_t;
+
+// Map a .wav file and locate its format and data chunks, skipping any others
+// (LIST, fact, cue, ...). The mapping is pre-faulted so reading the samples never
+// page-faults later. Returns false (after printing why) if the file is not a
+// valid RIFF/WAVE file.
+bool WaveFile_open(const char *fileName, waveFile_t *pWave);
+
+// Unmap a file opened with WaveFile_open.
+void WaveFile_close(waveFile_t *pWave);
+
+// True if the data is in the given PCM format and suitably aligned, so the
+// samples can be used in place without any copy or conversion.
+bool WaveFile_isPcm16(const waveFile_t *pWave, int channels, int sampleRate);
+
+#endif